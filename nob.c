@@ -6,17 +6,20 @@
 Procs procs = {0};
 
 #include "./src_build/flags.c"
+#include "./src/route_hash.h"
 typedef enum {
     BF_FORCE,
     BF_ASAN,
+    BF_MINIFY,
     BF_HELP,
     COUNT_BUILD_FLAGS
 } Build_Flag_Index;
-static_assert(COUNT_BUILD_FLAGS == 3, "Amount of build flags has changed");
+static_assert(COUNT_BUILD_FLAGS == 4, "Amount of build flags has changed");
 static Flag build_flags[COUNT_BUILD_FLAGS] = {
-    [BF_FORCE] = {.name = "-f",     .description = "Force full rebuild"},
-    [BF_ASAN]  = {.name = "-asan",  .description = "Enable address sanitizer"},
-    [BF_HELP]  = {.name = "-h",     .description = "Print build flags"},
+    [BF_FORCE]  = {.name = "-f",      .description = "Force full rebuild"},
+    [BF_ASAN]   = {.name = "-asan",   .description = "Enable address sanitizer"},
+    [BF_MINIFY] = {.name = "-minify", .description = "Drop the whitespace-only text between the code blocks of the templates"},
+    [BF_HELP]   = {.name = "-h",      .description = "Print build flags"},
 };
 
 // Folder must end with forward slash /
@@ -99,22 +102,142 @@ void usage(const char *program_name)
 
 bool compile_template(Cmd *cmd, const char *src_path, const char *dst_path)
 {
-    cmd_append(cmd, BUILD_FOLDER"tt", src_path);
+    cmd_append(cmd, BUILD_FOLDER"tt");
+    if (build_flags[BF_MINIFY].value) cmd_append(cmd, "-minify");
+    cmd_append(cmd, src_path);
     if (!cmd_run(cmd, .stdout_path = dst_path)) return false;;
     return true;
 }
 
-// TODO: maybe automatically recursively collect all the *.png, *.css files in "./resources/"?
-struct {
-    const char *file_path;
+typedef struct {
+    uint64_t etag;
     size_t offset;
-    size_t size;
-} resources[] = {
-    { .file_path = RESOURCES_FOLDER"images/tore.png" },
-    { .file_path = RESOURCES_FOLDER"css/reset.css"   },
-    { .file_path = RESOURCES_FOLDER"css/main.css"    },
+    size_t size;        // 0 means the variant does not exist
+    size_t head_offset;
+    size_t head_size;
+} Resource_Variant;
+
+typedef struct {
+    const char *file_path;
+    const char *content_type;
+    Resource_Variant identity;
+    Resource_Variant gzip;
+} Resource;
+
+typedef struct {
+    Resource *items;
+    size_t count;
+    size_t capacity;
+} Resources;
+
+// Only the files with these extensions are picked up from RESOURCES_FOLDER. Everything else there
+// (like the sources of the images) is skipped.
+struct {
+    const char *extension;
+    const char *content_type;
+} resource_types[] = {
+    { .extension = ".css", .content_type = "text/css"  },
+    { .extension = ".png", .content_type = "image/png" },
 };
 
+const char *resource_content_type(const char *file_path)
+{
+    size_t n = strlen(file_path);
+    for (size_t i = 0; i < NOB_ARRAY_LEN(resource_types); ++i) {
+        size_t m = strlen(resource_types[i].extension);
+        if (n >= m && strcmp(file_path + n - m, resource_types[i].extension) == 0) {
+            return resource_types[i].content_type;
+        }
+    }
+    return NULL;
+}
+
+// dir_path must end with forward slash /
+bool collect_resources(const char *dir_path, Resources *resources)
+{
+    bool result = true;
+    Nob_File_Paths children = {0};
+    if (!nob_read_entire_dir(dir_path, &children)) nob_return_defer(false);
+    for (size_t i = 0; i < children.count; ++i) {
+        if (children.items[i][0] == '.') continue;
+        const char *file_path = nob_temp_sprintf("%s%s", dir_path, children.items[i]);
+        Nob_File_Type type = nob_get_file_type(file_path);
+        if (type < 0) nob_return_defer(false);
+        if (type == NOB_FILE_DIRECTORY) {
+            if (!collect_resources(nob_temp_sprintf("%s/", file_path), resources)) nob_return_defer(false);
+            continue;
+        }
+        const char *content_type = resource_content_type(file_path);
+        if (type != NOB_FILE_REGULAR || content_type == NULL) {
+            nob_log(NOB_INFO, "Skipping %s", file_path);
+            continue;
+        }
+        Resource resource = { .file_path = file_path, .content_type = content_type };
+        nob_da_append(resources, resource);
+    }
+defer:
+    free(children.items);
+    return result;
+}
+
+int compare_resources(const void *a, const void *b)
+{
+    return strcmp(((const Resource*)a)->file_path, ((const Resource*)b)->file_path);
+}
+
+// The URLs of the resources are not versioned, so they can't be cached forever. After a week the
+// browsers revalidate them with the ETag, which is cheap anyway.
+#define RESOURCE_CACHE_CONTROL "public, max-age=604800"
+
+// FNV-1a. The bundle is immutable, so the hash of the content is a perfectly fine strong ETag.
+uint64_t resource_etag(const char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Compresses the resource with the gzip(1) of the host, so we don't have to vendor zlib just for the build.
+// -n keeps the name and the timestamp of the file out of the output, so the builds are reproducible.
+// The output is named after the index of the resource, because the resources in different folders may
+// share the same name.
+bool gzip_resource(Nob_Cmd *cmd, size_t index, const char *file_path, Nob_String_Builder *compressed)
+{
+    const char *gz_path = nob_temp_sprintf(BUILD_FOLDER"resource-%zu.gz", index);
+    nob_cmd_append(cmd, "gzip", "-9", "-n", "-c", file_path);
+    if (!nob_cmd_run(cmd, .stdout_path = gz_path)) return false;
+    compressed->count = 0;
+    return nob_read_entire_file(gz_path, compressed);
+}
+
+void bundle_variant(Nob_String_Builder *bundle, Resource_Variant *variant, const char *data, size_t size)
+{
+    variant->etag = resource_etag(data, size);
+    variant->offset = bundle->count;
+    variant->size = size;
+    nob_da_append_many(bundle, data, size);
+    nob_da_append(bundle, 0);
+}
+
+// The response heads are rendered right here and bundled as well, so `serve` can send the resources
+// without rendering or copying anything. They lack the final \r\n, because the Connection header
+// depends on the request.
+void bundle_variant_head(Nob_String_Builder *bundle, Resource_Variant *variant, const char *content_type, const char *content_encoding, bool vary)
+{
+    variant->head_offset = bundle->count;
+    nob_sb_appendf(bundle, "HTTP/1.1 200 OK\r\n");
+    nob_sb_appendf(bundle, "Content-Type: %s\r\n", content_type);
+    if (content_encoding) nob_sb_appendf(bundle, "Content-Encoding: %s\r\n", content_encoding);
+    if (vary) nob_sb_appendf(bundle, "Vary: Accept-Encoding\r\n");
+    nob_sb_appendf(bundle, "Content-Length: %zu\r\n", variant->size);
+    nob_sb_appendf(bundle, "ETag: \"%016llx\"\r\n", (unsigned long long)variant->etag);
+    nob_sb_appendf(bundle, "Cache-Control: %s\r\n", RESOURCE_CACHE_CONTROL);
+    variant->head_size = bundle->count - variant->head_offset;
+    nob_da_append(bundle, 0);
+}
+
 #define genf(out, ...) \
     do { \
         fprintf((out), __VA_ARGS__); \
@@ -126,11 +249,18 @@ struct {
         fprintf((out), " // %s:%d\n", __FILE__, __LINE__); \
     } while(0)
 
-bool generate_resource_bundle(void)
+void gen_variant(FILE *out, const char *name, Resource_Variant variant)
+{
+    genf(out, "        .%s = {.etag = \"\\\"%016llx\\\"\", .offset = %zu, .size = %zu, .head_offset = %zu, .head_size = %zu},",
+         name, (unsigned long long)variant.etag, variant.offset, variant.size, variant.head_offset, variant.head_size);
+}
+
+bool generate_resource_bundle(Nob_Cmd *cmd, Resources *resources)
 {
     bool result = true;
     Nob_String_Builder bundle = {0};
     Nob_String_Builder content = {0};
+    Nob_String_Builder compressed = {0};
     FILE *out = NULL;
 
     const char *bundle_h_path = BUILD_FOLDER"bundle.h";
@@ -140,14 +270,29 @@ bool generate_resource_bundle(void)
     // content = []
     // 0, 9
 
-    for (size_t i = 0; i < NOB_ARRAY_LEN(resources); ++i) {
-        nob_log(NOB_INFO, "Bundling %s into %s", resources[i].file_path, bundle_h_path);
+    for (size_t i = 0; i < resources->count; ++i) {
+        nob_log(NOB_INFO, "Bundling %s into %s", resources->items[i].file_path, bundle_h_path);
         content.count = 0;
-        if (!nob_read_entire_file(resources[i].file_path, &content)) nob_return_defer(false);
-        resources[i].offset = bundle.count;
-        resources[i].size = content.count;
-        nob_da_append_many(&bundle, content.items, content.count);
-        nob_da_append(&bundle, 0);
+        if (!nob_read_entire_file(resources->items[i].file_path, &content)) nob_return_defer(false);
+        bundle_variant(&bundle, &resources->items[i].identity, content.items, content.count);
+
+        // The images are compressed already, so we don't even try
+        if (strncmp(resources->items[i].content_type, "text/", 5) != 0) continue;
+        if (!gzip_resource(cmd, i, resources->items[i].file_path, &compressed)) {
+            nob_log(NOB_WARNING, "Could not compress %s. It is going to be served uncompressed.", resources->items[i].file_path);
+            continue;
+        }
+        if (compressed.count < content.count) {
+            bundle_variant(&bundle, &resources->items[i].gzip, compressed.items, compressed.count);
+        }
+    }
+
+    for (size_t i = 0; i < resources->count; ++i) {
+        bool vary = resources->items[i].gzip.size > 0;
+        bundle_variant_head(&bundle, &resources->items[i].identity, resources->items[i].content_type, NULL, vary);
+        if (resources->items[i].gzip.size > 0) {
+            bundle_variant_head(&bundle, &resources->items[i].gzip, resources->items[i].content_type, "gzip", vary);
+        }
     }
 
     out = fopen(bundle_h_path, "wb");
@@ -158,16 +303,29 @@ bool generate_resource_bundle(void)
 
     genf(out, "#ifndef BUNDLE_H_");
     genf(out, "#define BUNDLE_H_");
+    genf(out, "#define RESOURCE_CACHE_CONTROL \"%s\"", RESOURCE_CACHE_CONTROL);
     genf(out, "typedef struct {");
-    genf(out, "    const char *file_path;");
+    genf(out, "    const char *etag;");
     genf(out, "    size_t offset;");
     genf(out, "    size_t size;");
+    genf(out, "    size_t head_offset;");
+    genf(out, "    size_t head_size;");
+    genf(out, "} Resource_Variant;");
+    genf(out, "typedef struct {");
+    genf(out, "    const char *file_path;");
+    genf(out, "    const char *content_type;");
+    genf(out, "    Resource_Variant identity;");
+    genf(out, "    Resource_Variant gzip;  // .size == 0 if there is no gzip variant");
     genf(out, "} Resource;");
-    genf(out, "size_t resources_count = %zu;", NOB_ARRAY_LEN(resources));
+    genf(out, "size_t resources_count = %zu;", resources->count);
     genf(out, "Resource resources[] = {");
-    for (size_t i = 0; i < NOB_ARRAY_LEN(resources); ++i) {
-        genf(out, "    {.file_path = \"%s\", .offset = %zu, .size = %zu},",
-             resources[i].file_path, resources[i].offset, resources[i].size);
+    for (size_t i = 0; i < resources->count; ++i) {
+        genf(out, "    {");
+        genf(out, "        .file_path = \"%s\",", resources->items[i].file_path);
+        genf(out, "        .content_type = \"%s\",", resources->items[i].content_type);
+        gen_variant(out, "identity", resources->items[i].identity);
+        if (resources->items[i].gzip.size > 0) gen_variant(out, "gzip", resources->items[i].gzip);
+        genf(out, "    },");
     }
     genf(out, "};");
 
@@ -186,10 +344,238 @@ bool generate_resource_bundle(void)
 defer:
     if (out) fclose(out);
     free(content.items);
+    free(compressed.items);
     free(bundle.items);
     return result;
 }
 
+// The routes with a fixed path. `kind` is the name of the Route_Kind in tore.c, the generated
+// table is compiled right into it. On top of these every resource is served by its path relative
+// to RESOURCES_FOLDER.
+struct {
+    const char *path;
+    const char *kind;
+    int status_code;            // ROUTE_ERROR
+    const char *resource_path;  // ROUTE_RESOURCE
+} fixed_routes[] = {
+    { .path = "/",            .kind = "ROUTE_INDEX"   },
+    { .path = "/version",     .kind = "ROUTE_VERSION" },
+    { .path = "/favicon.ico", .kind = "ROUTE_RESOURCE", .resource_path = RESOURCES_FOLDER"images/tore.png" },
+    { .path = "/urmom",       .kind = "ROUTE_ERROR",    .status_code = 413 },
+    { .path = "/api/notifications", .kind = "ROUTE_API_NOTIFICATIONS" },
+    { .path = "/api/reminders",     .kind = "ROUTE_API_REMINDERS"     },
+    { .path = "/api/stats",         .kind = "ROUTE_API_STATS"         },
+    { .path = "/events",            .kind = "ROUTE_EVENTS"            },
+};
+
+// The routes with a parameter after the prefix. tore.c knows how to parse the parameter of each kind.
+struct {
+    const char *prefix;
+    const char *kind;
+} prefix_routes[] = {
+    { .prefix = "/notif/",             .kind = "ROUTE_NOTIF"     },
+    { .prefix = "/api/notifications/", .kind = "ROUTE_API_NOTIF" },
+};
+
+typedef struct {
+    const char *path;
+    const char *kind;
+    int status_code;
+    int resource;   // Index in resources[] or -1
+} Route_Def;
+
+typedef struct {
+    Route_Def *items;
+    size_t count;
+    size_t capacity;
+} Route_Defs;
+
+typedef struct {
+    unsigned char byte;
+    int first_child;
+    int next_sibling;
+    int prefix;     // Index in prefix_routes[] or -1
+} Route_Trie_Node;
+
+typedef struct {
+    Route_Trie_Node *items;
+    size_t count;
+    size_t capacity;
+} Route_Trie;
+
+// Tries seeds until every route lands in its own slot of the table. The table is at least twice as
+// big as the amount of the routes, so it doesn't take many attempts. If it does, the table grows.
+bool find_perfect_route_hash(Route_Defs *defs, size_t *table_size, uint32_t *seed)
+{
+    bool result = true;
+    *table_size = 1;
+    while (*table_size < defs->count*2) *table_size *= 2;
+    bool *taken = NULL;
+    for (;;) {
+        free(taken);
+        taken = calloc(*table_size, sizeof(*taken));
+        NOB_ASSERT(taken != NULL && "Buy more RAM lol");
+        for (*seed = 0; *seed < 0x10000; *seed += 1) {
+            memset(taken, 0, *table_size*sizeof(*taken));
+            size_t i = 0;
+            for (; i < defs->count; ++i) {
+                uint32_t slot = route_hash(defs->items[i].path, strlen(defs->items[i].path), *seed) & (*table_size - 1);
+                if (taken[slot]) break;
+                taken[slot] = true;
+            }
+            if (i >= defs->count) nob_return_defer(true);
+        }
+        if (*table_size >= 0x10000) {
+            nob_log(NOB_ERROR, "Could not find a perfect hash for %zu routes", defs->count);
+            nob_return_defer(false);
+        }
+        *table_size *= 2;
+    }
+defer:
+    free(taken);
+    return result;
+}
+
+int route_trie_child(Route_Trie *trie, int node, unsigned char byte)
+{
+    for (int child = trie->items[node].first_child; child >= 0; child = trie->items[child].next_sibling) {
+        if (trie->items[child].byte == byte) return child;
+    }
+    Route_Trie_Node new_child = {
+        .byte = byte,
+        .first_child = -1,
+        .next_sibling = trie->items[node].first_child,
+        .prefix = -1,
+    };
+    nob_da_append(trie, new_child);
+    trie->items[node].first_child = trie->count - 1;
+    return trie->count - 1;
+}
+
+bool generate_routes(Resources *resources)
+{
+    bool result = true;
+    Route_Defs defs = {0};
+    Route_Trie trie = {0};
+    Route_Def *table = NULL;
+    FILE *out = NULL;
+
+    const char *routes_h_path = BUILD_FOLDER"routes.h";
+
+    for (size_t i = 0; i < NOB_ARRAY_LEN(fixed_routes); ++i) {
+        Route_Def def = {
+            .path = fixed_routes[i].path,
+            .kind = fixed_routes[i].kind,
+            .status_code = fixed_routes[i].status_code,
+            .resource = -1,
+        };
+        if (fixed_routes[i].resource_path) {
+            for (size_t j = 0; j < resources->count; ++j) {
+                if (strcmp(resources->items[j].file_path, fixed_routes[i].resource_path) == 0) {
+                    def.resource = j;
+                    break;
+                }
+            }
+            if (def.resource < 0) {
+                nob_log(NOB_ERROR, "Route %s refers to a resource %s that does not exist", def.path, fixed_routes[i].resource_path);
+                nob_return_defer(false);
+            }
+        }
+        nob_da_append(&defs, def);
+    }
+    for (size_t i = 0; i < resources->count; ++i) {
+        Route_Def def = {
+            .path = nob_temp_sprintf("/%s", resources->items[i].file_path + strlen(RESOURCES_FOLDER)),
+            .kind = "ROUTE_RESOURCE",
+            .resource = i,
+        };
+        nob_da_append(&defs, def);
+    }
+    for (size_t i = 0; i < defs.count; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            if (strcmp(defs.items[i].path, defs.items[j].path) == 0) {
+                nob_log(NOB_ERROR, "Route %s is defined twice", defs.items[i].path);
+                nob_return_defer(false);
+            }
+        }
+    }
+
+    size_t table_size = 0;
+    uint32_t seed = 0;
+    if (!find_perfect_route_hash(&defs, &table_size, &seed)) nob_return_defer(false);
+    table = calloc(table_size, sizeof(*table));
+    NOB_ASSERT(table != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < defs.count; ++i) {
+        table[route_hash(defs.items[i].path, strlen(defs.items[i].path), seed) & (table_size - 1)] = defs.items[i];
+    }
+
+    // Node 0 is the root that matches the empty string
+    Route_Trie_Node root = { .first_child = -1, .next_sibling = -1, .prefix = -1 };
+    nob_da_append(&trie, root);
+    for (size_t i = 0; i < NOB_ARRAY_LEN(prefix_routes); ++i) {
+        int node = 0;
+        for (const char *c = prefix_routes[i].prefix; *c; ++c) node = route_trie_child(&trie, node, *c);
+        trie.items[node].prefix = i;
+    }
+
+    nob_log(NOB_INFO, "Generating %s: %zu routes in %zu slots with seed %u", routes_h_path, defs.count, table_size, seed);
+    out = fopen(routes_h_path, "wb");
+    if (out == NULL) {
+        nob_log(NOB_ERROR, "Could not open file %s for writing: %s", routes_h_path, strerror(errno));
+        nob_return_defer(false);
+    }
+
+    genf(out, "#ifndef ROUTES_H_");
+    genf(out, "#define ROUTES_H_");
+    genf(out, "typedef struct {");
+    genf(out, "    const char *path;   // NULL if the slot is empty");
+    genf(out, "    size_t path_len;");
+    genf(out, "    Route_Kind kind;");
+    genf(out, "    int status_code;");
+    genf(out, "    int resource;       // Index in resources[] or -1");
+    genf(out, "} Route_Entry;");
+    genf(out, "typedef struct {");
+    genf(out, "    const char *prefix;");
+    genf(out, "    size_t prefix_len;");
+    genf(out, "    Route_Kind kind;");
+    genf(out, "} Route_Prefix;");
+    genf(out, "typedef struct {");
+    genf(out, "    unsigned char byte;");
+    genf(out, "    int first_child;");
+    genf(out, "    int next_sibling;");
+    genf(out, "    int prefix;         // Index in route_prefixes[] or -1");
+    genf(out, "} Route_Trie_Node;");
+    genf(out, "#define ROUTE_HASH_SEED %uu", seed);
+    genf(out, "#define ROUTE_TABLE_SIZE %zu", table_size);
+    genf(out, "static const Route_Entry route_table[ROUTE_TABLE_SIZE] = {");
+    for (size_t i = 0; i < table_size; ++i) {
+        if (table[i].path == NULL) continue;
+        genf(out, "    [%zu] = {.path = \"%s\", .path_len = %zu, .kind = %s, .status_code = %d, .resource = %d},",
+             i, table[i].path, strlen(table[i].path), table[i].kind, table[i].status_code, table[i].resource);
+    }
+    genf(out, "};");
+    genf(out, "static const Route_Prefix route_prefixes[] = {");
+    for (size_t i = 0; i < NOB_ARRAY_LEN(prefix_routes); ++i) {
+        genf(out, "    {.prefix = \"%s\", .prefix_len = %zu, .kind = %s},",
+             prefix_routes[i].prefix, strlen(prefix_routes[i].prefix), prefix_routes[i].kind);
+    }
+    genf(out, "};");
+    genf(out, "static const Route_Trie_Node route_trie[] = {");
+    for (size_t i = 0; i < trie.count; ++i) {
+        genf(out, "    {.byte = 0x%02X, .first_child = %d, .next_sibling = %d, .prefix = %d},",
+             trie.items[i].byte, trie.items[i].first_child, trie.items[i].next_sibling, trie.items[i].prefix);
+    }
+    genf(out, "};");
+    genf(out, "#endif // ROUTES_H_");
+
+defer:
+    if (out) fclose(out);
+    free(table);
+    free(trie.items);
+    free(defs.items);
+    return result;
+}
+
 struct {
     const char *src_path;
     const char *dst_path;
@@ -214,12 +600,19 @@ bool build_tore(Cmd *cmd)
             return false;
         }
     }
-    if (!generate_resource_bundle()) return false;
+    Resources resources = {0};
+    if (!collect_resources(RESOURCES_FOLDER, &resources)) return false;
+    // nob_read_entire_dir() lists the files in no particular order, but the bundle should be reproducible
+    qsort(resources.items, resources.count, sizeof(*resources.items), compare_resources);
+    bool generated = generate_resource_bundle(cmd, &resources) && generate_routes(&resources);
+    free(resources.items);
+    if (!generated) return false;
 
     char *git_hash = get_git_hash(cmd);
     builder_compiler(cmd);
     builder_common_flags(cmd);
     if (!build_flags[BF_ASAN].value) cmd_append(cmd, "-static");
+    cmd_append(cmd, "-pthread");
     if (git_hash) {
         cmd_append(cmd, temp_sprintf("-DGIT_HASH=\"%s\"", git_hash));
         free(git_hash);
@@ -233,9 +626,44 @@ bool build_tore(Cmd *cmd)
     return true;
 }
 
+typedef struct {
+    const char *src_path;
+    const char *bin_path;
+    bool sanitize;          // Build with AddressSanitizer, for the checks that are after memory errors
+} Check;
+
+// The checks #include src/tore.c to get to its internals, so they are built like tore itself
+static Check checks[] = {
+    { .src_path = SRC_BUILD_FOLDER"check_query_plans.c", .bin_path = BUILD_FOLDER"check_query_plans" },
+    { .src_path = SRC_BUILD_FOLDER"check_html_escape.c", .bin_path = BUILD_FOLDER"check_html_escape" },
+    { .src_path = SRC_BUILD_FOLDER"check_serve_events.c", .bin_path = BUILD_FOLDER"check_serve_events", .sanitize = true },
+    { .src_path = SRC_BUILD_FOLDER"check_tui_refresh.c", .bin_path = BUILD_FOLDER"check_tui_refresh" },
+};
+
+bool run_checks(Cmd *cmd)
+{
+    bool result = true;
+    for (size_t i = 0; i < ARRAY_LEN(checks); ++i) {
+        builder_compiler(cmd);
+        builder_common_flags(cmd);
+        cmd_append(cmd, "-pthread", "-DGIT_HASH=\"check\"");
+        if (checks[i].sanitize) cmd_append(cmd, "-fsanitize=address");
+        builder_output(cmd, checks[i].bin_path);
+        builder_inputs(cmd, checks[i].src_path, SQLITE3_OBJ_PATH);
+        if (!cmd_run(cmd)) return false;
+
+        cmd_append(cmd, checks[i].bin_path);
+        if (!cmd_run(cmd)) {
+            nob_log(ERROR, "%s failed", checks[i].src_path);
+            result = false;
+        }
+    }
+    return result;
+}
+
 int main(int argc, char **argv)
 {
-    NOB_GO_REBUILD_URSELF_PLUS(argc, argv, "./src_build/flags.c");
+    NOB_GO_REBUILD_URSELF_PLUS(argc, argv, "./src_build/flags.c", "./src/route_hash.h");
 
     const char *program_name = shift(argv, argc);
     Nob_Cmd cmd = {0};
@@ -268,6 +696,11 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    if (strcmp(command_name, "check") == 0) {
+        if (!run_checks(&cmd)) return 1;
+        return 0;
+    }
+
     if (strcmp(command_name, "svg") == 0) {
         cmd_append(&cmd, "convert",
                 "-background", "None", "./assets/images/tore.svg",
@@ -0,0 +1,18 @@
+#ifndef ROUTE_HASH_H_
+#define ROUTE_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Seeded FNV-1a. It's shared by nob.c, which searches for a seed that makes the hash perfect on the
+// known routes, and tore.c, which looks the routes up with that seed. So they must never diverge.
+static inline uint32_t route_hash(const char *data, size_t size, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+#endif // ROUTE_HASH_H_
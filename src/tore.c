@@ -1,12 +1,30 @@
+#define _GNU_SOURCE // wcwidth()
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include "sqlite3.h"
 
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/ioctl.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <termios.h>
+#include <locale.h>
+#include <wchar.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
 
 #define NOB_IMPLEMENTATION
 #define NOB_STRIP_PREFIX
@@ -14,39 +32,253 @@
 #include "nob.h"
 
 #include "bundle.h"
+#include "route_hash.h"
 
 #define TORE_DIR_NAME ".tore"
 #define TORE_DB_NAME "db"
 #define TORE_TITLE_FILE_NAME "TITLE"
+#define TORE_CHECKOUT_CACHE_FILE_NAME "checkout-cache"
+#define TORE_DAEMON_SOCKET_FILE_NAME "daemon.sock"
+#define TORE_DB_BUSY_TIMEOUT_MS 5000
 #define STR(x) STR2_ELECTRIC_BOOGALOO(x)
 #define STR2_ELECTRIC_BOOGALOO(x) #x
 #define DEFAULT_SERVE_PORT 6969
 #define DEFAULT_COMMAND "checkout"
 
+// What to do with the firings of a periodic Reminder that were missed because `checkout` was not
+// run for a while (for example a `1d` Reminder that was last seen 200 days ago).
+typedef enum {
+    CATCH_UP_COLLAPSE,   // Fire off a single Notification no matter how many periods were missed
+    CATCH_UP_EACH,       // Fire off one Notification per missed period, but no more than CATCH_UP_EACH_MAX_FIRINGS
+} Catch_Up_Policy;
+
+// So a daily Reminder that was not seen for years does not flood the Mailbox with thousands of Notifications
+#define CATCH_UP_EACH_MAX_FIRINGS 31
+
 // Computed at runtime in main()
 static const char *HOME_PATH = NULL;
 static const char *TORE_DIR_PATH = NULL;
 static const char *TORE_DB_PATH = NULL;
+static const char *TORE_CHECKOUT_CACHE_PATH = NULL;
+static const char *TORE_DAEMON_SOCKET_PATH = NULL;
 static bool TORE_TRACE_MIGRATION_QUERIES = false;
+static Catch_Up_Policy TORE_CATCH_UP_POLICY = CATCH_UP_COLLAPSE;
 
 #define LOG_SQLITE3_ERROR(db) fprintf(stderr, "%s:%d: SQLITE3 ERROR: %s\n", __FILE__, __LINE__, sqlite3_errmsg(db))
 
-bool txn_begin(sqlite3 *db)
+// Prepared statements are cached per connection and keyed by their SQL text, so the queries that are
+// executed over and over again (like the ones in `serve`) are prepared only once per connection.
+// Statements obtained by stmt_prepare() must be given back by stmt_release() instead of sqlite3_finalize()
+// and the connections must be closed by close_tore_db() which finalizes all of their cached statements.
+// The cache is per thread, so a connection must be opened, used and closed by the same thread.
+typedef struct {
+    sqlite3 *db;
+    char *sql;
+    sqlite3_stmt *stmt;
+    bool in_use;
+} Cached_Stmt;
+
+typedef struct {
+    Cached_Stmt *items;
+    size_t count;
+    size_t capacity;
+} Stmt_Cache;
+
+static _Thread_local Stmt_Cache stmt_cache = {0};
+
+// Returns the SQLite result code just like sqlite3_prepare_v2()
+int stmt_prepare(sqlite3 *db, const char *sql, sqlite3_stmt **stmt)
+{
+    for (size_t i = 0; i < stmt_cache.count; ++i) {
+        Cached_Stmt *it = &stmt_cache.items[i];
+        if (it->db == db && !it->in_use && strcmp(it->sql, sql) == 0) {
+            it->in_use = true;
+            *stmt = it->stmt;
+            return SQLITE_OK;
+        }
+    }
+
+    int ret = sqlite3_prepare_v2(db, sql, -1, stmt, NULL);
+    if (ret != SQLITE_OK) return ret;
+    da_append(&stmt_cache, ((Cached_Stmt) {
+        .db = db,
+        .sql = strdup(sql),
+        .stmt = *stmt,
+        .in_use = true,
+    }));
+    return SQLITE_OK;
+}
+
+void stmt_release(sqlite3_stmt *stmt)
+{
+    for (size_t i = 0; i < stmt_cache.count; ++i) {
+        Cached_Stmt *it = &stmt_cache.items[i];
+        if (it->stmt == stmt) {
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+            it->in_use = false;
+            return;
+        }
+    }
+    UNREACHABLE("stmt_release: statement was not obtained by stmt_prepare");
+}
+
+void close_tore_db(sqlite3 *db)
+{
+    for (size_t i = 0; i < stmt_cache.count; ) {
+        Cached_Stmt *it = &stmt_cache.items[i];
+        if (it->db == db) {
+            sqlite3_finalize(it->stmt);
+            free(it->sql);
+            da_remove_unordered(&stmt_cache, i);
+        } else {
+            i += 1;
+        }
+    }
+    sqlite3_close(db);
+}
+
+// Executes a single statement that does not return any rows
+bool stmt_exec(sqlite3 *db, const char *sql)
 {
-    if (sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK) {
+    bool result = true;
+    sqlite3_stmt *stmt = NULL;
+
+    if (stmt_prepare(db, sql, &stmt) != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
-        return false;
+        return_defer(false);
     }
-    return true;
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+
+defer:
+    if (stmt) stmt_release(stmt);
+    return result;
+}
+
+bool txn_begin(sqlite3 *db)
+{
+    return stmt_exec(db, "BEGIN;");
+}
+
+// Takes the write lock right away. A deferred transaction that reads first and writes later can't be
+// retried by the busy handler when another connection commits in between (SQLITE_BUSY_SNAPSHOT), while
+// this one simply waits for the lock within the busy timeout.
+bool txn_begin_write(sqlite3 *db)
+{
+    return stmt_exec(db, "BEGIN IMMEDIATE;");
 }
 
 bool txn_commit(sqlite3 *db)
 {
-    if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+    return stmt_exec(db, "COMMIT;");
+}
+
+bool txn_rollback(sqlite3 *db)
+{
+    return stmt_exec(db, "ROLLBACK;");
+}
+
+// Runs a query that is expected to return a single integer (like most of the PRAGMAs)
+bool query_int(sqlite3 *db, const char *sql, int *value)
+{
+    bool result = true;
+    sqlite3_stmt *stmt = NULL;
+
+    if (stmt_prepare(db, sql, &stmt) != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
-        return false;
+        return_defer(false);
     }
-    return true;
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+    *value = sqlite3_column_int(stmt, 0);
+
+defer:
+    if (stmt) stmt_release(stmt);
+    return result;
+}
+
+// Growing chunked allocator that is reset all at once. The `serve` workers use it instead of the nob
+// temporary buffer, which is a single global shared by all the threads.
+typedef struct Arena_Region Arena_Region;
+
+struct Arena_Region {
+    Arena_Region *next;
+    size_t count;
+    size_t capacity;
+    char data[];
+};
+
+typedef struct {
+    Arena_Region *begin;
+    Arena_Region *end;
+} Arena;
+
+#define ARENA_REGION_DEFAULT_CAPACITY (64*1024)
+
+Arena_Region *arena_new_region(size_t capacity)
+{
+    Arena_Region *region = malloc(sizeof(*region) + capacity);
+    assert(region != NULL && "Buy more RAM lol");
+    region->next = NULL;
+    region->count = 0;
+    region->capacity = capacity;
+    return region;
+}
+
+void *arena_alloc(Arena *a, size_t size)
+{
+    size = (size + sizeof(uintptr_t) - 1)&~(sizeof(uintptr_t) - 1);
+    if (a->end == NULL) {
+        a->begin = a->end = arena_new_region(size > ARENA_REGION_DEFAULT_CAPACITY ? size : ARENA_REGION_DEFAULT_CAPACITY);
+    }
+    // The regions after the end are left over from before the last arena_reset()
+    while (a->end->count + size > a->end->capacity && a->end->next != NULL) {
+        a->end = a->end->next;
+    }
+    if (a->end->count + size > a->end->capacity) {
+        a->end->next = arena_new_region(size > ARENA_REGION_DEFAULT_CAPACITY ? size : ARENA_REGION_DEFAULT_CAPACITY);
+        a->end = a->end->next;
+    }
+    void *result = &a->end->data[a->end->count];
+    a->end->count += size;
+    return result;
+}
+
+void arena_reset(Arena *a)
+{
+    for (Arena_Region *region = a->begin; region != NULL; region = region->next) {
+        region->count = 0;
+    }
+    a->end = a->begin;
+}
+
+void arena_free(Arena *a)
+{
+    Arena_Region *region = a->begin;
+    while (region != NULL) {
+        Arena_Region *next = region->next;
+        free(region);
+        region = next;
+    }
+    a->begin = NULL;
+    a->end = NULL;
+}
+
+// Where the strings loaded from the database are allocated. NULL means the nob temporary buffer.
+static _Thread_local Arena *scratch_arena = NULL;
+
+char *scratch_strdup(const char *cstr)
+{
+    if (scratch_arena == NULL) return temp_strdup(cstr);
+    size_t n = strlen(cstr) + 1;
+    char *result = arena_alloc(scratch_arena, n);
+    memcpy(result, cstr, n);
+    return result;
 }
 
 const char *migrations[] = {
@@ -78,15 +310,68 @@ const char *migrations[] = {
     ");\n"
     "INSERT INTO Notifications (id, title, created_at, dismissed_at)\n"
     "SELECT id, title, created_at, dismissed_at FROM Notifications_old;\n"
-    "DROP TABLE Notifications_old;\n"
+    "DROP TABLE Notifications_old;\n",
+
+    // Indexes for the hot queries, so they do not scan through the whole history of dismissed Notifications and finished Reminders
+    "CREATE INDEX IF NOT EXISTS Notifications_active_by_group ON Notifications (ifnull(reminder_id, -id), created_at) WHERE dismissed_at IS NULL;\n",
+    "CREATE INDEX IF NOT EXISTS Reminders_active_by_scheduled_at ON Reminders (scheduled_at) WHERE finished_at IS NULL;\n",
+
+    // Keyset pagination of the active grouped Notifications seeks by the page key, which is the time of the first Notification in the group
+    "CREATE INDEX IF NOT EXISTS Notifications_active_by_created_at ON Notifications (created_at, ifnull(reminder_id, -id)) WHERE dismissed_at IS NULL;\n",
+
+    // Every change of a Notification bumps its version past all the others. The writers are serialized by
+    // sqlite3, so the versions grow in the order of the commits and a reader that remembers the last version
+    // it has seen can pick up only the Notifications that changed after it.
+    "ALTER TABLE Notifications ADD COLUMN version INTEGER NOT NULL DEFAULT 0;\n"
+    "CREATE INDEX IF NOT EXISTS Notifications_by_version ON Notifications (version);\n"
+    "CREATE TRIGGER IF NOT EXISTS Notifications_version_on_insert AFTER INSERT ON Notifications BEGIN\n"
+    "    UPDATE Notifications SET version = (SELECT max(version) FROM Notifications) + 1 WHERE id = NEW.id;\n"
+    "END;\n"
+    "CREATE TRIGGER IF NOT EXISTS Notifications_version_on_update AFTER UPDATE OF title, dismissed_at, reminder_id ON Notifications BEGIN\n"
+    "    UPDATE Notifications SET version = (SELECT max(version) FROM Notifications) + 1 WHERE id = NEW.id;\n"
+    "END;\n",
 };
 
+// FNV-1a hash of all the migrations[]. It is stored in PRAGMA user_version after the migrations
+// are applied, so the common case of an up to date schema is a single PRAGMA read instead of
+// comparing every applied query. C cannot hash strings at compile time, but the migrations are
+// only a couple of kilobytes, so hashing them once per process is negligible.
+static int migrations_fingerprint_value = 0;
+static pthread_once_t migrations_fingerprint_once = PTHREAD_ONCE_INIT;
+
+void migrations_fingerprint_compute(void)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < ARRAY_LEN(migrations); ++i) {
+        // Including the terminating NULL so the boundaries between the migrations matter
+        for (const char *c = migrations[i]; ; ++c) {
+            hash = (hash ^ (unsigned char)*c) * 16777619u;
+            if (*c == '\0') break;
+        }
+    }
+    // user_version of a fresh database is 0, so it must never be a valid fingerprint
+    migrations_fingerprint_value = hash == 0 ? 1 : (int)hash;
+}
+
+// The workers of `serve` open their connections concurrently, hence pthread_once()
+int migrations_fingerprint(void)
+{
+    pthread_once(&migrations_fingerprint_once, migrations_fingerprint_compute);
+    return migrations_fingerprint_value;
+}
+
 // TODO: can we just extract tore_path from db somehow?
 bool create_schema(sqlite3 *db, const char *tore_path)
 {
     bool result = true;
     sqlite3_stmt *stmt = NULL;
-    if (!txn_begin(db)) return_defer(false);
+
+    int user_version = 0;
+    if (!query_int(db, "PRAGMA user_version;", &user_version)) return false;
+    if (user_version == migrations_fingerprint()) return true;
+
+    // Slow path: the fingerprint does not match, so we check the applied migrations one by one
+    if (!txn_begin_write(db)) return_defer(false);
     const char *sql =
         "CREATE TABLE IF NOT EXISTS Migrations (\n"
         "    applied_at DATETIME NOT NULL DEFAULT CURRENT_TIMESTAMP,\n"
@@ -154,6 +439,11 @@ bool create_schema(sqlite3 *db, const char *tore_path)
         stmt = NULL;
     }
 
+    if (sqlite3_exec(db, temp_sprintf("PRAGMA user_version = %d;", migrations_fingerprint()), NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+
 defer:
     if (stmt) sqlite3_finalize(stmt);
     if (result) result = txn_commit(db);
@@ -180,7 +470,7 @@ int load_notification_by_id(sqlite3 *db, int notif_id, Notification *notif)
     bool result = true;
     sqlite3_stmt *stmt = NULL;
 
-    int ret = sqlite3_prepare_v2(db,
+    int ret = stmt_prepare(db,
         "SELECT\n"
         "    id,\n"
         "    title,\n"
@@ -189,7 +479,7 @@ int load_notification_by_id(sqlite3 *db, int notif_id, Notification *notif)
         "    reminder_id,\n"
         "    ifnull(reminder_id, -id)\n"
         "FROM Notifications WHERE id = ?;",
-        -1, &stmt, NULL);
+        &stmt);
     if (ret != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(-1);
@@ -221,15 +511,15 @@ int load_notification_by_id(sqlite3 *db, int notif_id, Notification *notif)
 
     *notif = (Notification) {
         .id           = id,
-        .title        = title        ? temp_strdup(title)        : NULL,
-        .created_at   = created_at   ? temp_strdup(created_at)   : NULL,
-        .dismissed_at = dismissed_at ? temp_strdup(dismissed_at) : NULL,
+        .title        = title        ? scratch_strdup(title)        : NULL,
+        .created_at   = created_at   ? scratch_strdup(created_at)   : NULL,
+        .dismissed_at = dismissed_at ? scratch_strdup(dismissed_at) : NULL,
         .reminder_id  = reminder_id,
         .group_id     = group_id,
     };
 
 defer:
-    if (stmt) sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
     return result;
 }
 
@@ -238,7 +528,7 @@ bool load_active_notifications_of_group(sqlite3 *db, int group_id, Notifications
     bool result = true;
     sqlite3_stmt *stmt = NULL;
 
-    int ret = sqlite3_prepare_v2(db,
+    int ret = stmt_prepare(db,
         "SELECT\n"
         "    id,\n"
         "    title,\n"
@@ -247,7 +537,7 @@ bool load_active_notifications_of_group(sqlite3 *db, int group_id, Notifications
         "    reminder_id,\n"
         "    ifnull(reminder_id, -id) as group_id\n"
         "FROM Notifications WHERE dismissed_at IS NULL AND group_id = ? ORDER BY ts;",
-        -1, &stmt, NULL);
+        &stmt);
     if (ret != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
@@ -268,9 +558,9 @@ bool load_active_notifications_of_group(sqlite3 *db, int group_id, Notifications
         int group_id = sqlite3_column_int(stmt, column++);
         da_append(ns, ((Notification) {
             .id           = id,
-            .title        = title        ? temp_strdup(title)        : NULL,
-            .created_at   = created_at   ? temp_strdup(created_at)   : NULL,
-            .dismissed_at = dismissed_at ? temp_strdup(dismissed_at) : NULL,
+            .title        = title        ? scratch_strdup(title)        : NULL,
+            .created_at   = created_at   ? scratch_strdup(created_at)   : NULL,
+            .dismissed_at = dismissed_at ? scratch_strdup(dismissed_at) : NULL,
             .reminder_id  = reminder_id,
             .group_id     = group_id,
         }));
@@ -282,7 +572,7 @@ bool load_active_notifications_of_group(sqlite3 *db, int group_id, Notifications
     }
 
 defer:
-    if (stmt) sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
     return result;
 }
 
@@ -323,10 +613,10 @@ bool load_active_grouped_notifications(sqlite3 *db, Grouped_Notifications *notif
     // TODO: Also consider using Twitter Snowlakes ID instead of UUIDs
     //   https://en.wikipedia.org/wiki/Snowflake_ID
 
-    int ret = sqlite3_prepare_v2(db,
+    int ret = stmt_prepare(db,
         "SELECT id, title, datetime(created_at, 'localtime') as ts, reminder_id, ifnull(reminder_id, -id) as group_id, count(*) as group_count "
         "FROM Notifications WHERE dismissed_at IS NULL GROUP BY group_id ORDER BY ts;",
-        -1, &stmt, NULL);
+        &stmt);
     if (ret != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
@@ -335,8 +625,8 @@ bool load_active_grouped_notifications(sqlite3 *db, Grouped_Notifications *notif
     for (ret = sqlite3_step(stmt); ret == SQLITE_ROW; ret = sqlite3_step(stmt)) {
         int column = 0;
         int notif_id = sqlite3_column_int(stmt, column++);
-        const char *title = temp_strdup((const char *)sqlite3_column_text(stmt, column++));
-        const char *created_at = temp_strdup((const char *)sqlite3_column_text(stmt, column++));
+        const char *title = scratch_strdup((const char *)sqlite3_column_text(stmt, column++));
+        const char *created_at = scratch_strdup((const char *)sqlite3_column_text(stmt, column++));
         int reminder_id = sqlite3_column_int(stmt, column++);
         int group_id = sqlite3_column_int(stmt, column++);
         int group_count = sqlite3_column_int(stmt, column++);
@@ -356,23 +646,81 @@ bool load_active_grouped_notifications(sqlite3 *db, Grouped_Notifications *notif
     }
 
 defer:
-    if (stmt) sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
     return result;
 }
 
-void display_grouped_notifications(Grouped_Notifications gns)
+// Appends the group if it still has any active Notifications
+bool load_active_grouped_notification_by_group_id(sqlite3 *db, int group_id, Grouped_Notifications *notifs)
+{
+    bool result = true;
+    sqlite3_stmt *stmt = NULL;
+
+    int ret = stmt_prepare(db,
+        "SELECT id, title, datetime(created_at, 'localtime') as ts, reminder_id, ifnull(reminder_id, -id) as group_id, count(*) as group_count "
+        "FROM Notifications WHERE dismissed_at IS NULL AND ifnull(reminder_id, -id) = ? GROUP BY group_id;",
+        &stmt);
+    if (ret != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+
+    if (sqlite3_bind_int(stmt, 1, group_id) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+
+    ret = sqlite3_step(stmt);
+    if (ret == SQLITE_ROW) {
+        int column = 0;
+        int notif_id = sqlite3_column_int(stmt, column++);
+        const char *title = scratch_strdup((const char *)sqlite3_column_text(stmt, column++));
+        const char *created_at = scratch_strdup((const char *)sqlite3_column_text(stmt, column++));
+        int reminder_id = sqlite3_column_int(stmt, column++);
+        int group_id = sqlite3_column_int(stmt, column++);
+        int group_count = sqlite3_column_int(stmt, column++);
+        da_append(notifs, ((Grouped_Notification) {
+            .notif_id = notif_id,
+            .title = title,
+            .created_at = created_at,
+            .reminder_id = reminder_id,
+            .group_id = group_id,
+            .group_count = group_count,
+        }));
+        ret = sqlite3_step(stmt);
+    }
+
+    if (ret != SQLITE_DONE) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+
+defer:
+    if (stmt) stmt_release(stmt);
+    return result;
+}
+
+void render_grouped_notifications(String_Builder *sb, Grouped_Notifications gns)
 {
     for (size_t i = 0; i < gns.count; ++i) {
         Grouped_Notification *it = &gns.items[i];
         assert(it->group_count > 0);
         if (it->group_count == 1) {
-            printf("%zu: %s (%s)\n", i, it->title, it->created_at);
+            sb_appendf(sb, "%zu: %s (%s)\n", i, it->title, it->created_at);
         } else {
-            printf("%zu: [%d] %s (%s)\n", i, it->group_count, it->title, it->created_at);
+            sb_appendf(sb, "%zu: [%d] %s (%s)\n", i, it->group_count, it->title, it->created_at);
         }
     }
 }
 
+void display_grouped_notifications(Grouped_Notifications gns)
+{
+    String_Builder sb = {0};
+    render_grouped_notifications(&sb, gns);
+    fwrite(sb.items, 1, sb.count, stdout);
+    free(sb.items);
+}
+
 bool show_active_notifications(sqlite3 *db)
 {
     bool result = true;
@@ -416,10 +764,10 @@ bool dismiss_grouped_notification_by_group_id(sqlite3 *db, int group_id)
     bool result = true;
     sqlite3_stmt *stmt = NULL;
 
-    int ret = sqlite3_prepare_v2(db,
+    int ret = stmt_prepare(db,
             "UPDATE Notifications SET dismissed_at = CURRENT_TIMESTAMP "
-            "WHERE dismissed_at is NULL AND ifnull(reminder_id, -id) = ?", -1,
-            &stmt, NULL);
+            "WHERE dismissed_at is NULL AND ifnull(reminder_id, -id) = ?",
+            &stmt);
     if (ret != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
@@ -436,7 +784,7 @@ bool dismiss_grouped_notification_by_group_id(sqlite3 *db, int group_id)
     }
 
 defer:
-    if (stmt) sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
     return result;
 }
 
@@ -465,7 +813,7 @@ bool update_notification_title(sqlite3 *db, int notif_id, const char *title)
 {
     bool result = true;
     sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db, "UPDATE Notifications SET title = ? WHERE id = ?;", -1, &stmt, NULL) != SQLITE_OK) {
+    if (stmt_prepare(db, "UPDATE Notifications SET title = ? WHERE id = ?;", &stmt) != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
     }
@@ -483,7 +831,7 @@ bool update_notification_title(sqlite3 *db, int notif_id, const char *title)
         return_defer(false);
     }
 defer:
-    if (stmt) sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
     return result;
 }
 
@@ -492,7 +840,7 @@ bool create_notification_with_title(sqlite3 *db, const char *title)
     bool result = true;
     sqlite3_stmt *stmt = NULL;
 
-    if (sqlite3_prepare_v2(db, "INSERT INTO Notifications (title) VALUES (?)", -1, &stmt, NULL) != SQLITE_OK) {
+    if (stmt_prepare(db, "INSERT INTO Notifications (title) VALUES (?)", &stmt) != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
     }
@@ -506,7 +854,7 @@ bool create_notification_with_title(sqlite3 *db, const char *title)
     }
 
 defer:
-    if (stmt) sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
     return result;
 }
 
@@ -529,7 +877,7 @@ bool load_active_reminders(sqlite3 *db, Reminders *reminders)
 
     sqlite3_stmt *stmt = NULL;
 
-    int ret = sqlite3_prepare_v2(db, "SELECT id, title, scheduled_at, period FROM Reminders WHERE finished_at IS NULL ORDER BY scheduled_at DESC", -1, &stmt, NULL);
+    int ret = stmt_prepare(db, "SELECT id, title, scheduled_at, period FROM Reminders WHERE finished_at IS NULL ORDER BY scheduled_at DESC", &stmt);
     if (ret != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
@@ -537,10 +885,10 @@ bool load_active_reminders(sqlite3 *db, Reminders *reminders)
 
     for (ret = sqlite3_step(stmt); ret == SQLITE_ROW; ret = sqlite3_step(stmt)) {
         int id = sqlite3_column_int(stmt, 0);
-        const char *title = temp_strdup((const char *)sqlite3_column_text(stmt, 1));
-        const char *scheduled_at = temp_strdup((const char *)sqlite3_column_text(stmt, 2));
+        const char *title = scratch_strdup((const char *)sqlite3_column_text(stmt, 1));
+        const char *scheduled_at = scratch_strdup((const char *)sqlite3_column_text(stmt, 2));
         const char *period = (const char *)sqlite3_column_text(stmt, 3);
-        if (period != NULL) period = temp_strdup(period);
+        if (period != NULL) period = scratch_strdup(period);
         da_append(reminders, ((Reminder) {
             .id = id,
             .title = title,
@@ -554,153 +902,373 @@ bool load_active_reminders(sqlite3 *db, Reminders *reminders)
         return_defer(false);
     }
 defer:
-    if (stmt) sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
     return result;
 }
 
-typedef enum {
-    PERIOD_KIND_NONE,
-    PERIOD_KIND_DAY,
-    PERIOD_KIND_WEEK,
-    PERIOD_KIND_MONTH,
-    PERIOD_KIND_YEAR,
-    COUNT_PERIOD_KINDS,
-} Period_Kind;
+// Position in a list ordered by (key, id), so the next page starts right after it no matter how many
+// rows were inserted or deleted before it in the meantime. Unlike OFFSET, the rows before it are never visited.
+#define PAGE_CURSOR_KEY_CAPACITY 32
 
 typedef struct {
-    Period_Kind kind;
-    unsigned long length;
-} Period;
+    bool present;       // false means the first page
+    char key[PAGE_CURSOR_KEY_CAPACITY];
+    int id;
+} Page_Cursor;
 
-typedef struct {
-    const char *modifier;
-    const char *name;
-} Period_Modifier;
+#define PAGE_DEFAULT_LIMIT 100
+#define PAGE_MAX_LIMIT 1000
 
-static_assert(COUNT_PERIOD_KINDS == 5, "Amount of periods have changed");
-Period_Modifier tore_period_modifiers[COUNT_PERIOD_KINDS] = {
-    [PERIOD_KIND_DAY]   = { .modifier = "d", .name = "days"   },
-    [PERIOD_KIND_WEEK]  = { .modifier = "w", .name = "weeks"  },
-    [PERIOD_KIND_MONTH] = { .modifier = "m", .name = "months" },
-    [PERIOD_KIND_YEAR]  = { .modifier = "y", .name = "years"  },
-};
+// ?limit=<n>&after=<key>:<id>. The index page shows two lists, so it takes the cursor of the
+// Reminders separately in &reminders_after=<key>:<id>.
+typedef struct {
+    size_t limit;
+    Page_Cursor after;
+    Page_Cursor reminders_after;
+} Page_Query;
 
-bool parse_period_from_cstr(const char *unparsed_period, Period *period)
+void page_cursor_from_row(sqlite3_stmt *stmt, int key_column, int id_column, Page_Cursor *cursor)
 {
-    memset(period, 0, sizeof(*period));
+    cursor->present = true;
+    snprintf(cursor->key, sizeof(cursor->key), "%s", (const char *)sqlite3_column_text(stmt, key_column));
+    cursor->id = sqlite3_column_int(stmt, id_column);
+}
 
-    if (strcmp(unparsed_period, "none") == 0) return true;
+// Columns of the page of the active grouped Notifications. The names are the field names in the JSON API.
+// The last one is only for the cursor.
+#define NOTIFS_PAGE_JSON_COLUMNS 6
+#define NOTIFS_PAGE_KEY_COLUMN 6
+#define NOTIFS_PAGE_ID_COLUMN 4
 
-    char *endptr = NULL;
-    period->length = strtoul(unparsed_period, &endptr, 10);
-    if (endptr == unparsed_period) {
-        fprintf(stderr, "ERROR: Invalid period `%s`. Expected something like\n", unparsed_period);
-        for (Period_Kind pk = 0; pk < COUNT_PERIOD_KINDS; ++pk) {
-            Period_Modifier *pm = &tore_period_modifiers[pk];
-            if (pm->modifier) {
-                size_t l = rand()%9 + 1;
-                fprintf(stderr, "    %lu%s - means every %lu %s\n", l, pm->modifier, l, pm->name);
-            }
-        }
+// Ordered by the time of the first Notification in the group and then by group_id. The cursor key is
+// that time in unix seconds and the id is the group_id. Yields up to limit + 1 rows, so the caller
+// knows whether there is a next page.
+bool prepare_active_grouped_notifications_page(sqlite3 *db, Page_Cursor after, size_t limit, sqlite3_stmt **stmt)
+{
+    // Aggregating all the groups with GROUP BY and filtering them afterwards would cost every active
+    // Notification on each page. Instead it seeks Notifications_active_by_created_at right past the
+    // cursor and walks it in the page order. The NOT EXISTS probe of Notifications_active_by_group skips
+    // everything but the first Notification of each group. The walk stops after LIMIT groups, and
+    // group_count is counted only for those. The first page binds NULL, which compares as '' below
+    // every created_at.
+    int ret = stmt_prepare(db,
+        "SELECT n.id, n.title, datetime(n.created_at, 'localtime') AS created_at, n.reminder_id, ifnull(n.reminder_id, -n.id) AS group_id,\n"
+        "       (SELECT count(*) FROM Notifications c WHERE c.dismissed_at IS NULL AND ifnull(c.reminder_id, -c.id) = ifnull(n.reminder_id, -n.id)) AS group_count,\n"
+        "       CAST(strftime('%s', n.created_at) AS INTEGER) AS since\n"
+        "FROM Notifications n\n"
+        "WHERE n.dismissed_at IS NULL\n"
+        "  AND (n.created_at, ifnull(n.reminder_id, -n.id)) > (ifnull(datetime(?1, 'unixepoch'), ''), ?2)\n"
+        "  AND NOT EXISTS (\n"
+        "      SELECT 1 FROM Notifications p\n"
+        "      WHERE p.dismissed_at IS NULL AND ifnull(p.reminder_id, -p.id) = ifnull(n.reminder_id, -n.id)\n"
+        "        AND (p.created_at, p.id) < (n.created_at, n.id))\n"
+        "ORDER BY n.created_at, ifnull(n.reminder_id, -n.id) LIMIT ?3;",
+        stmt);
+    if (ret != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
         return false;
     }
-    unparsed_period = endptr;
-
-    for (Period_Kind pk = 0; pk < COUNT_PERIOD_KINDS; ++pk) {
-        Period_Modifier *pm = &tore_period_modifiers[pk];
-        if (pm->modifier && strcmp(pm->modifier, unparsed_period) == 0) {
-            period->kind = pk;
-            return true;
-        }
-    }
-
-    fprintf(stderr, "ERROR: Unknown period modifier `%s`. Expected modifiers are\n", unparsed_period);
-    for (Period_Kind pk = 0; pk < COUNT_PERIOD_KINDS; ++pk) {
-        Period_Modifier *pm = &tore_period_modifiers[pk];
-        if (pm->modifier) {
-            fprintf(stderr, "    %lu%s  - means every %lu %s\n", period->length, pm->modifier, period->length, pm->name);
-        }
-    }
 
-    return false;
-}
-
-const char *render_period_as_sqlite3_datetime_modifier_temp(Period period)
-{
-    switch (period.kind) {
-    case PERIOD_KIND_NONE:  return NULL;
-    case PERIOD_KIND_DAY:   return temp_sprintf("+%lu days",   period.length);
-    case PERIOD_KIND_WEEK:  return temp_sprintf("+%lu days",   period.length*7);
-    case PERIOD_KIND_MONTH: return temp_sprintf("+%lu months", period.length);
-    case PERIOD_KIND_YEAR:  return temp_sprintf("+%lu years",  period.length);
-    case COUNT_PERIOD_KINDS:
-    default: UNREACHABLE("render_period_as_sqlite3_datetime_modifier_temp");
+    int column = 0;
+    ret = after.present
+        ? sqlite3_bind_int64(*stmt, ++column, strtoll(after.key, NULL, 10))
+        : sqlite3_bind_null(*stmt, ++column);
+    if (ret == SQLITE_OK) ret = sqlite3_bind_int(*stmt, ++column, after.id);
+    if (ret == SQLITE_OK) ret = sqlite3_bind_int64(*stmt, ++column, limit + 1);
+    if (ret != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        stmt_release(*stmt);
+        *stmt = NULL;
+        return false;
     }
+    return true;
 }
 
-bool create_new_reminder(sqlite3 *db, const char *title, const char *scheduled_at, Period period)
+// Loads at most `limit` groups. *next is set to the cursor of the last one if there are more.
+bool load_active_grouped_notifications_page(sqlite3 *db, Page_Cursor after, size_t limit, Grouped_Notifications *notifs, Page_Cursor *next)
 {
     bool result = true;
-
     sqlite3_stmt *stmt = NULL;
 
-    if (sqlite3_prepare_v2(db, "INSERT INTO Reminders (title, scheduled_at, period) VALUES (?, ?, ?)", -1, &stmt, NULL) != SQLITE_OK) {
-        LOG_SQLITE3_ERROR(db);
-        return_defer(false);
-    }
-    if (sqlite3_bind_text(stmt, 1, title, strlen(title), NULL) != SQLITE_OK) {
-        LOG_SQLITE3_ERROR(db);
-        return_defer(false);
-    }
-    if (sqlite3_bind_text(stmt, 2, scheduled_at, strlen(scheduled_at), NULL) != SQLITE_OK) {
+    if (!prepare_active_grouped_notifications_page(db, after, limit, &stmt)) return_defer(false);
+
+    Page_Cursor last = {0};
+    *next = (Page_Cursor) {0};
+    int ret = 0;
+    for (ret = sqlite3_step(stmt); ret == SQLITE_ROW; ret = sqlite3_step(stmt)) {
+        if (notifs->count >= limit) {
+            *next = last;
+            break;
+        }
+        int column = 0;
+        int notif_id = sqlite3_column_int(stmt, column++);
+        const char *title = scratch_strdup((const char *)sqlite3_column_text(stmt, column++));
+        const char *created_at = scratch_strdup((const char *)sqlite3_column_text(stmt, column++));
+        int reminder_id = sqlite3_column_int(stmt, column++);
+        int group_id = sqlite3_column_int(stmt, column++);
+        int group_count = sqlite3_column_int(stmt, column++);
+        da_append(notifs, ((Grouped_Notification) {
+            .notif_id = notif_id,
+            .title = title,
+            .created_at = created_at,
+            .reminder_id = reminder_id,
+            .group_id = group_id,
+            .group_count = group_count,
+        }));
+        page_cursor_from_row(stmt, NOTIFS_PAGE_KEY_COLUMN, NOTIFS_PAGE_ID_COLUMN, &last);
+    }
+
+    if (ret != SQLITE_DONE && ret != SQLITE_ROW) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
     }
-    const char *rendered_period = render_period_as_sqlite3_datetime_modifier_temp(period);
-    if (sqlite3_bind_text(stmt, 3, rendered_period, rendered_period ? strlen(rendered_period) : 0, NULL) != SQLITE_OK) {
+
+defer:
+    if (stmt) stmt_release(stmt);
+    return result;
+}
+
+#define REMINDERS_PAGE_JSON_COLUMNS 4
+#define REMINDERS_PAGE_KEY_COLUMN 2
+#define REMINDERS_PAGE_ID_COLUMN 0
+
+// Ordered like load_active_reminders(), but with the ids breaking the ties. The cursor key is the
+// scheduled_at date and the id is the id of the Reminder. Yields up to limit + 1 rows.
+bool prepare_active_reminders_page(sqlite3 *db, Page_Cursor after, size_t limit, sqlite3_stmt **stmt)
+{
+    // Walks the Reminders_active_by_scheduled_at index backwards. The rowid is the implicit last column of
+    // every index, so the ORDER BY does not need a sorter.
+    int ret = stmt_prepare(db,
+        "SELECT id, title, scheduled_at, period FROM Reminders\n"
+        "WHERE finished_at IS NULL AND (?1 IS NULL OR (scheduled_at, id) < (?1, ?2))\n"
+        "ORDER BY scheduled_at DESC, id DESC LIMIT ?3;",
+        stmt);
+    if (ret != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
-        return_defer(false);
+        return false;
     }
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
+
+    int column = 0;
+    ret = after.present
+        ? sqlite3_bind_text(*stmt, ++column, after.key, -1, NULL)
+        : sqlite3_bind_null(*stmt, ++column);
+    if (ret == SQLITE_OK) ret = sqlite3_bind_int(*stmt, ++column, after.id);
+    if (ret == SQLITE_OK) ret = sqlite3_bind_int64(*stmt, ++column, limit + 1);
+    if (ret != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        stmt_release(*stmt);
+        *stmt = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool load_active_reminders_page(sqlite3 *db, Page_Cursor after, size_t limit, Reminders *reminders, Page_Cursor *next)
+{
+    bool result = true;
+    sqlite3_stmt *stmt = NULL;
+
+    if (!prepare_active_reminders_page(db, after, limit, &stmt)) return_defer(false);
+
+    Page_Cursor last = {0};
+    *next = (Page_Cursor) {0};
+    int ret = 0;
+    for (ret = sqlite3_step(stmt); ret == SQLITE_ROW; ret = sqlite3_step(stmt)) {
+        if (reminders->count >= limit) {
+            *next = last;
+            break;
+        }
+        int id = sqlite3_column_int(stmt, 0);
+        const char *title = scratch_strdup((const char *)sqlite3_column_text(stmt, 1));
+        const char *scheduled_at = scratch_strdup((const char *)sqlite3_column_text(stmt, 2));
+        const char *period = (const char *)sqlite3_column_text(stmt, 3);
+        if (period != NULL) period = scratch_strdup(period);
+        da_append(reminders, ((Reminder) {
+            .id = id,
+            .title = title,
+            .scheduled_at = scheduled_at,
+            .period = period,
+        }));
+        page_cursor_from_row(stmt, REMINDERS_PAGE_KEY_COLUMN, REMINDERS_PAGE_ID_COLUMN, &last);
+    }
+
+    if (ret != SQLITE_DONE && ret != SQLITE_ROW) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
     }
 
 defer:
-    if (stmt) sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
     return result;
 }
 
-// NOTE: The general policy of the application is that all the date times are stored in GMT, but before displaying them and/or making logical decisions upon them they are converted to localtime.
-bool fire_off_reminders(sqlite3 *db)
+typedef enum {
+    PERIOD_KIND_NONE,
+    PERIOD_KIND_DAY,
+    PERIOD_KIND_WEEK,
+    PERIOD_KIND_MONTH,
+    PERIOD_KIND_YEAR,
+    COUNT_PERIOD_KINDS,
+} Period_Kind;
+
+typedef struct {
+    Period_Kind kind;
+    unsigned long length;
+} Period;
+
+typedef struct {
+    const char *modifier;
+    const char *name;
+} Period_Modifier;
+
+static_assert(COUNT_PERIOD_KINDS == 5, "Amount of periods have changed");
+Period_Modifier tore_period_modifiers[COUNT_PERIOD_KINDS] = {
+    [PERIOD_KIND_DAY]   = { .modifier = "d", .name = "days"   },
+    [PERIOD_KIND_WEEK]  = { .modifier = "w", .name = "weeks"  },
+    [PERIOD_KIND_MONTH] = { .modifier = "m", .name = "months" },
+    [PERIOD_KIND_YEAR]  = { .modifier = "y", .name = "years"  },
+};
+
+bool parse_period_from_cstr(const char *unparsed_period, Period *period)
+{
+    memset(period, 0, sizeof(*period));
+
+    if (strcmp(unparsed_period, "none") == 0) return true;
+
+    char *endptr = NULL;
+    period->length = strtoul(unparsed_period, &endptr, 10);
+    if (endptr == unparsed_period) {
+        fprintf(stderr, "ERROR: Invalid period `%s`. Expected something like\n", unparsed_period);
+        for (Period_Kind pk = 0; pk < COUNT_PERIOD_KINDS; ++pk) {
+            Period_Modifier *pm = &tore_period_modifiers[pk];
+            if (pm->modifier) {
+                size_t l = rand()%9 + 1;
+                fprintf(stderr, "    %lu%s - means every %lu %s\n", l, pm->modifier, l, pm->name);
+            }
+        }
+        return false;
+    }
+    unparsed_period = endptr;
+
+    for (Period_Kind pk = 0; pk < COUNT_PERIOD_KINDS; ++pk) {
+        Period_Modifier *pm = &tore_period_modifiers[pk];
+        if (pm->modifier && strcmp(pm->modifier, unparsed_period) == 0) {
+            period->kind = pk;
+            return true;
+        }
+    }
+
+    fprintf(stderr, "ERROR: Unknown period modifier `%s`. Expected modifiers are\n", unparsed_period);
+    for (Period_Kind pk = 0; pk < COUNT_PERIOD_KINDS; ++pk) {
+        Period_Modifier *pm = &tore_period_modifiers[pk];
+        if (pm->modifier) {
+            fprintf(stderr, "    %lu%s  - means every %lu %s\n", period->length, pm->modifier, period->length, pm->name);
+        }
+    }
+
+    return false;
+}
+
+const char *render_period_as_sqlite3_datetime_modifier_temp(Period period)
+{
+    switch (period.kind) {
+    case PERIOD_KIND_NONE:  return NULL;
+    case PERIOD_KIND_DAY:   return temp_sprintf("+%lu days",   period.length);
+    case PERIOD_KIND_WEEK:  return temp_sprintf("+%lu days",   period.length*7);
+    case PERIOD_KIND_MONTH: return temp_sprintf("+%lu months", period.length);
+    case PERIOD_KIND_YEAR:  return temp_sprintf("+%lu years",  period.length);
+    case COUNT_PERIOD_KINDS:
+    default: UNREACHABLE("render_period_as_sqlite3_datetime_modifier_temp");
+    }
+}
+
+bool create_new_reminder(sqlite3 *db, const char *title, const char *scheduled_at, Period period)
 {
     bool result = true;
 
     sqlite3_stmt *stmt = NULL;
 
-    // Creating new notifications from fired off reminders
-    const char *sql = "INSERT INTO Notifications (title, reminder_id) SELECT title, id FROM Reminders WHERE scheduled_at <= date('now', 'localtime') AND finished_at IS NULL";
-    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+    if (stmt_prepare(db, "INSERT INTO Reminders (title, scheduled_at, period) VALUES (?, ?, ?)", &stmt) != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
     }
-
-    // Finish all the non-periodic reminders
-    sql = "UPDATE Reminders SET finished_at = CURRENT_TIMESTAMP WHERE scheduled_at <= date('now', 'localtime') AND finished_at IS NULL AND period is NULL";
-    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+    if (sqlite3_bind_text(stmt, 1, title, strlen(title), NULL) != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
     }
-
-    // Reschedule all the period reminders
-    sql = "UPDATE Reminders SET scheduled_at = date(scheduled_at, period) WHERE scheduled_at <= date('now', 'localtime') AND finished_at IS NULL AND period is NOT NULL";
-    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+    if (sqlite3_bind_text(stmt, 2, scheduled_at, strlen(scheduled_at), NULL) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+    const char *rendered_period = render_period_as_sqlite3_datetime_modifier_temp(period);
+    if (sqlite3_bind_text(stmt, 3, rendered_period, rendered_period ? strlen(rendered_period) : 0, NULL) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
     }
 
 defer:
-    sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
+    return result;
+}
+
+// NOTE: The general policy of the application is that all the date times are stored in GMT, but before displaying them and/or making logical decisions upon them they are converted to localtime.
+//
+// All the periods a Reminder has missed are caught up in a single run. The recursive CTE walks each due
+// Reminder period by period until it reaches the future or runs into `limit_condition` on the firing
+// number n. The `date(at, period) > at` condition stops the recursion on periods that do not move the
+// date forward (like `+0 days`).
+#define REMINDER_FIRINGS_CTE(limit_condition) \
+    "WITH RECURSIVE Firings(id, title, at, period, n) AS (\n" \
+    "    SELECT id, title, scheduled_at, period, 1 FROM Reminders WHERE scheduled_at <= date('now', 'localtime') AND finished_at IS NULL\n" \
+    "    UNION ALL\n" \
+    "    SELECT id, title, date(at, period), period, n + 1 FROM Firings\n" \
+    "    WHERE period IS NOT NULL AND date(at, period) > at AND date(at, period) <= date('now', 'localtime') " limit_condition "\n" \
+    ")\n"
+bool fire_off_reminders(sqlite3 *db)
+{
+    bool result = true;
+
+    // Creating new notifications from fired off reminders
+    const char *sql = NULL;
+    switch (TORE_CATCH_UP_POLICY) {
+    case CATCH_UP_EACH:
+        sql = REMINDER_FIRINGS_CTE("AND n < " STR(CATCH_UP_EACH_MAX_FIRINGS)) "INSERT INTO Notifications (title, reminder_id) SELECT title, id FROM Firings";
+        break;
+    case CATCH_UP_COLLAPSE:
+        sql = "INSERT INTO Notifications (title, reminder_id) SELECT title, id FROM Reminders WHERE scheduled_at <= date('now', 'localtime') AND finished_at IS NULL";
+        break;
+    default: UNREACHABLE("TORE_CATCH_UP_POLICY");
+    }
+    if (!stmt_exec(db, sql)) return_defer(false);
+
+    // Finish all the non-periodic reminders
+    sql = "UPDATE Reminders SET finished_at = CURRENT_TIMESTAMP WHERE scheduled_at <= date('now', 'localtime') AND finished_at IS NULL AND period is NULL";
+    if (!stmt_exec(db, sql)) return_defer(false);
+
+    // Reschedule the reminders with a period in days (and weeks, which are stored as days) right to the first
+    // period after today. Unlike walking the missed periods one by one it costs the same no matter how
+    // long ago the reminder was due.
+    sql =
+        "UPDATE Reminders SET scheduled_at = date(scheduled_at, printf('+%d days',\n"
+        "    (CAST(julianday(date('now', 'localtime')) - julianday(scheduled_at) AS INTEGER) / CAST(substr(period, 2) AS INTEGER) + 1) * CAST(substr(period, 2) AS INTEGER)))\n"
+        "WHERE scheduled_at <= date('now', 'localtime') AND finished_at IS NULL AND period LIKE '+% days' AND CAST(substr(period, 2) AS INTEGER) > 0";
+    if (!stmt_exec(db, sql)) return_defer(false);
+
+    // The rest of the periodic reminders (months and years) are rescheduled by walking their missed periods,
+    // because adding months does not distribute like adding days does (January 31 + 1 month is March 3rd or 2nd).
+    // That's at most 12 steps per year of absence.
+    sql =
+        REMINDER_FIRINGS_CTE("")
+        "UPDATE Reminders SET scheduled_at = date(Last.at, Reminders.period)\n"
+        "FROM (SELECT id, max(at) AS at FROM Firings GROUP BY id) AS Last\n"
+        "WHERE Reminders.id = Last.id AND Reminders.period IS NOT NULL";
+    if (!stmt_exec(db, sql)) return_defer(false);
+
+defer:
     return result;
 }
 
@@ -732,7 +1300,7 @@ bool remove_reminder_by_id(sqlite3 *db, int id)
 
     sqlite3_stmt *stmt = NULL;
 
-    int ret = sqlite3_prepare_v2(db, "UPDATE Reminders SET finished_at = CURRENT_TIMESTAMP WHERE id = ?", -1, &stmt, NULL);
+    int ret = stmt_prepare(db, "UPDATE Reminders SET finished_at = CURRENT_TIMESTAMP WHERE id = ?", &stmt);
     if (ret != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
@@ -749,7 +1317,7 @@ bool remove_reminder_by_id(sqlite3 *db, int id)
     }
 
 defer:
-    if (stmt) sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
     return result;
 }
 
@@ -759,7 +1327,7 @@ bool amend_reminder(sqlite3 *db, Reminder reminder)
 
     sqlite3_stmt *stmt = NULL;
 
-    int ret = sqlite3_prepare_v2(db, "UPDATE Reminders SET title = ?, scheduled_at = ?, period = ? WHERE id = ?", -1, &stmt, NULL);
+    int ret = stmt_prepare(db, "UPDATE Reminders SET title = ?, scheduled_at = ?, period = ? WHERE id = ?", &stmt);
     if (ret != SQLITE_OK) {
         LOG_SQLITE3_ERROR(db);
         return_defer(false);
@@ -789,7 +1357,7 @@ bool amend_reminder(sqlite3 *db, Reminder reminder)
     }
 
 defer:
-    if (stmt) sqlite3_finalize(stmt);
+    if (stmt) stmt_release(stmt);
     return result;
 }
 
@@ -836,30 +1404,186 @@ const char *verify_date_format(const char *date)
 }
 
 // Taken from https://stackoverflow.com/a/7382028
+static const char *html_entities[256] = {
+    ['&']  = "&amp;",
+    ['<']  = "&lt;",
+    ['>']  = "&gt;",
+    ['"']  = "&quot;",
+    ['\''] = "&#39;",
+};
+// 0 for the bytes that don't need escaping
+static const unsigned char html_entity_sizes[256] = {
+    ['&'] = 5, ['<'] = 4, ['>'] = 4, ['"'] = 6, ['\''] = 5,
+};
+
+#ifdef __SSE2__
+// Bit i of the result is set if buf[i] needs escaping
+static inline unsigned html_special_mask(const char *buf)
+{
+    __m128i block = _mm_loadu_si128((const __m128i*)buf);
+    __m128i special = _mm_cmpeq_epi8(block, _mm_set1_epi8('&'));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(block, _mm_set1_epi8('<')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(block, _mm_set1_epi8('>')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(block, _mm_set1_epi8('"')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(block, _mm_set1_epi8('\'')));
+    return _mm_movemask_epi8(special);
+}
+#endif // __SSE2__
+
+// The reference implementation. It's also what handles the tails shorter than a block.
+// Returns the end of the written output.
+char *html_escape_scalar(char *out, const char *buf, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char c = buf[i];
+        if (html_entity_sizes[c]) {
+            memcpy(out, html_entities[c], html_entity_sizes[c]);
+            out += html_entity_sizes[c];
+        } else {
+            *out++ = c;
+        }
+    }
+    return out;
+}
+
+size_t html_escaped_size(const char *buf, size_t size)
+{
+    size_t result = size;
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= size; i += 16) {
+        for (unsigned mask = html_special_mask(buf + i); mask != 0; mask &= mask - 1) {
+            result += html_entity_sizes[(unsigned char)buf[i + __builtin_ctz(mask)]] - 1;
+        }
+    }
+#endif // __SSE2__
+    for (; i < size; ++i) {
+        unsigned char c = buf[i];
+        if (html_entity_sizes[c]) result += html_entity_sizes[c] - 1;
+    }
+    return result;
+}
+
+// Most of the text has nothing to escape, so it's scanned 16 bytes at a time and the clean runs are
+// copied in bulk. The output is reserved upfront, so nothing is checked or grown while writing.
 void sb_append_html_escaped_buf(String_Builder *sb, const char *buf, size_t size)
 {
+    da_reserve(sb, sb->count + html_escaped_size(buf, size));
+    char *out = sb->items + sb->count;
+    size_t i = 0;
+#ifdef __SSE2__
+    while (i + 16 <= size) {
+        unsigned mask = html_special_mask(buf + i);
+        if (mask == 0) {
+            memcpy(out, buf + i, 16);
+            out += 16;
+            i += 16;
+            continue;
+        }
+        size_t clean = __builtin_ctz(mask);
+        memcpy(out, buf + i, clean);
+        out += clean;
+        i += clean;
+        out = html_escape_scalar(out, buf + i, 1);
+        i += 1;
+    }
+#endif // __SSE2__
+    out = html_escape_scalar(out, buf + i, size - i);
+    sb->count = out - sb->items;
+}
+
+// The digits are written straight into the builder, without vsnprintf() and the temporary storage
+// that sb_appendf() goes through
+void sb_append_size(String_Builder *sb, size_t x)
+{
+    size_t n = 1;
+    for (size_t y = x; y >= 10; y /= 10) n += 1;
+    da_reserve(sb, sb->count + n);
+    char *digits = sb->items + sb->count;
+    for (size_t i = n; i > 0; --i) {
+        digits[i - 1] = '0' + x%10;
+        x /= 10;
+    }
+    sb->count += n;
+}
+
+void sb_append_int(String_Builder *sb, long long x)
+{
+    if (x < 0) {
+        da_append(sb, '-');
+        sb_append_size(sb, 0 - (unsigned long long)x);
+    } else {
+        sb_append_size(sb, x);
+    }
+}
+
+// Most of the text needs no escaping at all, so it's copied in runs
+void sb_append_json_buf(String_Builder *sb, const char *buf, size_t size)
+{
+    static const char hex[] = "0123456789abcdef";
+    da_append(sb, '"');
+    size_t run = 0;
     for (size_t i = 0; i < size; ++i) {
-        switch (buf[i]) {
-            case '&':  sb_append_cstr(sb, "&amp;");  break;
-            case '<':  sb_append_cstr(sb, "&lt;");   break;
-            case '>':  sb_append_cstr(sb, "&gt;");   break;
-            case '"':  sb_append_cstr(sb, "&quot;"); break;
-            case '\'': sb_append_cstr(sb, "&#39;");  break;
-            default:   da_append(sb, buf[i]);
+        unsigned char c = buf[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        sb_append_buf(sb, buf + run, i - run);
+        run = i + 1;
+        switch (c) {
+        case '"':  sb_append_cstr(sb, "\\\""); break;
+        case '\\': sb_append_cstr(sb, "\\\\"); break;
+        case '\n': sb_append_cstr(sb, "\\n");  break;
+        case '\r': sb_append_cstr(sb, "\\r");  break;
+        case '\t': sb_append_cstr(sb, "\\t");  break;
+        default:
+            sb_append_cstr(sb, "\\u00");
+            da_append(sb, hex[c >> 4]);
+            da_append(sb, hex[c & 0xF]);
+        }
+    }
+    sb_append_buf(sb, buf + run, size - run);
+    da_append(sb, '"');
+}
+
+// Serializes the first `columns_count` columns of the current row as a JSON object. The names of the
+// columns are the names of the fields. The values go straight from SQLite's buffers into the builder.
+void sb_append_json_row(String_Builder *sb, sqlite3_stmt *stmt, int columns_count)
+{
+    da_append(sb, '{');
+    for (int column = 0; column < columns_count; ++column) {
+        if (column > 0) da_append(sb, ',');
+        const char *name = sqlite3_column_name(stmt, column);
+        sb_append_json_buf(sb, name, strlen(name));
+        da_append(sb, ':');
+        switch (sqlite3_column_type(stmt, column)) {
+        case SQLITE_NULL:
+            sb_append_cstr(sb, "null");
+            break;
+        case SQLITE_INTEGER:
+            sb_append_int(sb, sqlite3_column_int64(stmt, column));
+            break;
+        default: {
+            // sqlite3_column_bytes() must be called after sqlite3_column_text(), since the latter may convert the value
+            const char *text = (const char *)sqlite3_column_text(stmt, column);
+            sb_append_json_buf(sb, text, sqlite3_column_bytes(stmt, column));
+        }
         }
     }
+    da_append(sb, '}');
 }
 
-void render_index_page(String_Builder *sb, Grouped_Notifications notifs, Reminders reminders)
+// notifs_more and reminders_more are the links to the next pages or NULL if there are none
+void render_index_page(String_Builder *sb, Grouped_Notifications notifs, Reminders reminders, const char *notifs_more, const char *reminders_more)
 {
 #define OUT(buf, size) sb_append_buf(sb, buf, size);
+#define TEMPLATE_STATIC_BYTES(n) da_reserve(sb, sb->count + (n));
 #define ESCAPED(cstr) sb_append_html_escaped_buf(sb, cstr, strlen(cstr));
-#define INT(x) sb_append_cstr(sb, temp_sprintf("%d", (x)));
+#define INT(x) sb_append_int(sb, (x));
 #define PAGE_BODY "index_page.h"
 #define PAGE_TITLE
 #include "root_page.h"
 #undef PAGE_TITLE
 #undef PAGE_BODY
+#undef TEMPLATE_STATIC_BYTES
 #undef INT
 #undef ESCAPED
 #undef OUT
@@ -868,13 +1592,15 @@ void render_index_page(String_Builder *sb, Grouped_Notifications notifs, Reminde
 void render_error_page(String_Builder *sb, int error_code, const char *error_name)
 {
 #define OUT(buf, size) sb_append_buf(sb, buf, size);
-#define ERROR_CODE sb_append_cstr(sb, temp_sprintf("%d", error_code));
+#define TEMPLATE_STATIC_BYTES(n) da_reserve(sb, sb->count + (n));
+#define ERROR_CODE sb_append_int(sb, error_code);
 #define ERROR_NAME sb_append_cstr(sb, error_name);
 #define PAGE_BODY "error_page.h"
-#define PAGE_TITLE sb_append_cstr(sb, temp_sprintf(" - %d - %s", error_code, error_name));
+#define PAGE_TITLE sb_append_cstr(sb, " - "); ERROR_CODE sb_append_cstr(sb, " - "); ERROR_NAME
 #include "root_page.h"
 #undef PAGE_TITLE
 #undef PAGE_BODY
+#undef TEMPLATE_STATIC_BYTES
 #undef ERROR_CODE
 #undef ERROR_NAME
 #undef OUT
@@ -883,13 +1609,15 @@ void render_error_page(String_Builder *sb, int error_code, const char *error_nam
 void render_notif_page(String_Builder *sb, Notification notif)
 {
 #define OUT(buf, size) sb_append_buf(sb, buf, size);
+#define TEMPLATE_STATIC_BYTES(n) da_reserve(sb, sb->count + (n));
 #define ESCAPED(cstr) sb_append_html_escaped_buf(sb, cstr, strlen(cstr));
-#define INT(x) sb_append_cstr(sb, temp_sprintf("%d", (x)));
+#define INT(x) sb_append_int(sb, (x));
 #define PAGE_BODY "notif_page.h"
 #define PAGE_TITLE sb_append_cstr(sb, " - Notification - "); INT(notif.id);
 #include "root_page.h"
 #undef PAGE_TITLE
 #undef PAGE_BODY
+#undef TEMPLATE_STATIC_BYTES
 #undef INT
 #undef OUT
 #undef ESCAPED
@@ -898,12 +1626,14 @@ void render_notif_page(String_Builder *sb, Notification notif)
 void render_version_page(String_Builder *sb)
 {
 #define OUT(buf, size) sb_append_buf(sb, buf, size);
+#define TEMPLATE_STATIC_BYTES(n) da_reserve(sb, sb->count + (n));
 #define ESCAPED(cstr) sb_append_html_escaped_buf(sb, cstr, strlen(cstr));
 #define PAGE_BODY "version_page.h"
 #define PAGE_TITLE sb_append_cstr(sb, " - "); sb_append_cstr(sb, GIT_HASH);
 #include "root_page.h"
 #undef PAGE_TITLE
 #undef PAGE_BODY
+#undef TEMPLATE_STATIC_BYTES
 #undef ESCAPED
 #undef OUT
 }
@@ -948,8 +1678,29 @@ sqlite3 *open_tore_db(void)
         return_defer(NULL);
     }
 
+    // The `checkout` of a new shell, the daemon, the TUI and the workers of `serve` may all be using the
+    // database at the same time. In WAL mode the readers never block the writer and vice versa, and
+    // the writers wait for each other instead of failing right away.
+    sqlite3_busy_timeout(result, TORE_DB_BUSY_TIMEOUT_MS);
+    const char *pragmas =
+        "PRAGMA journal_mode = WAL;\n"
+        // In WAL mode NORMAL is still safe from corruption. A power loss may only roll back the last commits.
+        "PRAGMA synchronous = NORMAL;\n"
+        "PRAGMA cache_size = -8192;\n"       // KiB
+        "PRAGMA mmap_size = 268435456;\n"
+        "PRAGMA temp_store = MEMORY;\n";
+    if (sqlite3_exec(result, pragmas, NULL, NULL, NULL) != SQLITE_OK) {
+        // Not fatal, the database is just slower or more likely to be busy
+        LOG_SQLITE3_ERROR(result);
+    }
+
+    // By default the last connection to a database in WAL mode checkpoints and deletes the -wal file when
+    // it's closed, which happens after checkout_cache_save() took the fingerprint and would invalidate the
+    // cache every time. SQLite still checkpoints automatically once the -wal file grows big enough.
+    sqlite3_db_config(result, SQLITE_DBCONFIG_NO_CKPT_ON_CLOSE, 1, NULL);
+
     if (!create_schema(result, TORE_DB_PATH)) {
-        sqlite3_close(result);
+        close_tore_db(result);
         return_defer(NULL);
     }
 
@@ -957,38 +1708,261 @@ defer:
     return result;
 }
 
-typedef struct Command {
-    const char *name;
-    const char *description;
-    const char *signature;      // NULL means no signature
-    bool (*run)(struct Command *self, const char *program_name, int argc, char **argv);
-} Command;
+// The Checkout Cache is a sidecar file in TORE_DIR_PATH that contains the already rendered Mailbox
+// together with the date when the next Reminder is supposed to fire off. It allows `checkout` (which
+// runs on every new shell, since it's in everyone's .bashrc) to not touch the database at all until
+// either the next Reminder is due or somebody modifies the database file.
+//
+// Format:
+// ```
+// tore-checkout-cache <GIT_HASH>
+// <fingerprint of the database file>
+// <date of the next Reminder in YYYY-MM-DD or - if nothing is scheduled>
+// <rendered Mailbox...>
+// ```
+#define CHECKOUT_CACHE_MAGIC "tore-checkout-cache "GIT_HASH
+
+#define DATE_BUFFER_SIZE sizeof("YYYY-MM-DD")
 
-typedef enum {
-    DESCRIPTION_SHORT,
-    DESCRIPTION_FULL,
-} Description_Type;
+typedef struct {
+    bool prepared;
+    int data_version;
+    // Copied in, so the cache does not depend on the lifetime of the temporary buffer (the daemon keeps it
+    // across its iterations). Empty means nothing is scheduled.
+    char next_due[DATE_BUFFER_SIZE];
+    String_Builder mailbox;
+} Checkout_Cache;
+
+const char *today_local_temp(void)
+{
+    time_t now = time(NULL);
+    struct tm tm = {0};
+    localtime_r(&now, &tm);
+    char *result = temp_alloc(DATE_BUFFER_SIZE);
+    strftime(result, DATE_BUFFER_SIZE, "%Y-%m-%d", &tm);
+    return result;
+}
 
-void command_describe(Command command, const char *program_name, int pad, Description_Type description_type)
+time_t next_local_midnight(void)
 {
-    printf("%*s%s %s", pad, "", program_name, command.name);
-    if (command.signature) printf(" %s", command.signature);
-    printf("\n");
-    if (command.description) {
-        switch (description_type) {
-        case DESCRIPTION_SHORT: {
-            String_View description = sv_from_cstr(command.description);
-            String_View short_description = sv_chop_by_delim(&description, '\n');
-            printf("%*s    "SV_Fmt"\n", pad, "", SV_Arg(short_description));
-            if (sv_trim(description).count != 0)
-            printf("%*s    ...\n", pad + 2, "");
-        } break;
-        case DESCRIPTION_FULL: {
-            String_View description = sv_from_cstr(command.description);
-            while (description.count > 0) {
-                String_View line = sv_chop_by_delim(&description, '\n');
-                printf("%*s    "SV_Fmt"\n", pad, "", SV_Arg(line));
-            }
+    time_t now = time(NULL);
+    struct tm tm = {0};
+    localtime_r(&now, &tm);
+    tm.tm_mday += 1;
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+const char *file_stat_fingerprint_temp(const struct stat *st)
+{
+    return temp_sprintf("%lu %lld %lld %ld %lld %ld",
+                        (unsigned long)st->st_ino, (long long)st->st_size,
+                        (long long)st->st_mtim.tv_sec, st->st_mtim.tv_nsec,
+                        (long long)st->st_ctim.tv_sec, st->st_ctim.tv_nsec);
+}
+
+// Fingerprint changes every time anybody (including other processes or even the sqlite3 CLI) writes into the database file.
+// In WAL mode the commits land in the -wal file and reach the database file only on checkpoints, so it's fingerprinted too.
+// After a checkpoint the -wal file is reset and rewritten from the beginning, possibly up to the same size within the same
+// tick of the file system clock. Every reset changes the salts in its 32 bytes header though, so the header goes in as well.
+const char *tore_db_fingerprint_temp(void)
+{
+    struct stat st;
+    if (stat(TORE_DB_PATH, &st) < 0) return NULL;
+    const char *fingerprint = temp_sprintf("%lu %s", (unsigned long)st.st_dev, file_stat_fingerprint_temp(&st));
+
+    const char *wal_path = temp_sprintf("%s-wal", TORE_DB_PATH);
+    int fd = open(wal_path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) return NULL;
+        return temp_sprintf("%s -", fingerprint);
+    }
+    unsigned char header[32];
+    ssize_t n = fstat(fd, &st) < 0 ? -1 : read(fd, header, sizeof(header));
+    close(fd);
+    if (n < 0) return NULL;
+
+    // The -wal file is truncated when the last connection to the database closes
+    char header_hex[2*sizeof(header) + 1] = "-";
+    for (ssize_t i = 0; i < n; ++i) snprintf(header_hex + 2*i, 3, "%02x", header[i]);
+    return temp_sprintf("%s %s %s", fingerprint, file_stat_fingerprint_temp(&st), header_hex);
+}
+
+// Must be called within the same transaction that modified the database
+bool checkout_cache_prepare(sqlite3 *db, Checkout_Cache *cc)
+{
+    bool result = true;
+    sqlite3_stmt *stmt = NULL;
+    Grouped_Notifications gns = {0};
+
+    cc->mailbox.count = 0;
+    if (!load_active_grouped_notifications(db, &gns)) return_defer(false);
+    render_grouped_notifications(&cc->mailbox, gns);
+
+    if (stmt_prepare(db, "SELECT min(scheduled_at) FROM Reminders WHERE finished_at IS NULL;", &stmt) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+    const char *next_due = (const char *)sqlite3_column_text(stmt, 0);
+    snprintf(cc->next_due, sizeof(cc->next_due), "%s", next_due ? next_due : "");
+
+    if (!query_int(db, "PRAGMA data_version;", &cc->data_version)) return_defer(false);
+    cc->prepared = true;
+
+defer:
+    if (stmt) stmt_release(stmt);
+    free(gns.items);
+    return result;
+}
+
+// Must be called after the transaction is committed, but before the database is closed
+bool checkout_cache_save(sqlite3 *db, Checkout_Cache *cc)
+{
+    bool result = true;
+    String_Builder sb = {0};
+
+    if (!cc->prepared) return_defer(true);
+
+    const char *fingerprint = tore_db_fingerprint_temp();
+    if (fingerprint == NULL) return_defer(false);
+
+    // If some other process managed to sneak in its own modifications between our commit and
+    // the fingerprinting, the cache would have been describing the wrong state of the database.
+    int data_version = 0;
+    if (!query_int(db, "PRAGMA data_version;", &data_version)) return_defer(false);
+    if (data_version != cc->data_version) return_defer(false);
+
+    sb_appendf(&sb, "%s\n", CHECKOUT_CACHE_MAGIC);
+    sb_appendf(&sb, "%s\n", fingerprint);
+    sb_appendf(&sb, "%s\n", cc->next_due[0] ? cc->next_due : "-");
+    sb_append_buf(&sb, cc->mailbox.items, cc->mailbox.count);
+
+    // Writing into a temporary file and renaming it so a concurrent `checkout` never sees a half written cache
+    const char *tmp_path = temp_sprintf("%s.%d", TORE_CHECKOUT_CACHE_PATH, getpid());
+    if (!write_entire_file(tmp_path, sb.items, sb.count)) return_defer(false);
+    if (!nob_rename(tmp_path, TORE_CHECKOUT_CACHE_PATH)) return_defer(false);
+
+defer:
+    free(sb.items);
+    return result;
+}
+
+// Returns true and prints the Mailbox if the cache is still valid. Does not touch the database at all.
+bool checkout_cache_print(void)
+{
+    bool result = true;
+    String_Builder sb = {0};
+
+    int exists = file_exists(TORE_CHECKOUT_CACHE_PATH);
+    if (exists <= 0) return_defer(false);
+    if (!read_entire_file(TORE_CHECKOUT_CACHE_PATH, &sb)) return_defer(false);
+
+    String_View cache = sb_to_sv(sb);
+    String_View magic = sv_chop_by_delim(&cache, '\n');
+    if (!sv_eq(magic, sv_from_cstr(CHECKOUT_CACHE_MAGIC))) return_defer(false);
+
+    const char *fingerprint = tore_db_fingerprint_temp();
+    if (fingerprint == NULL) return_defer(false);
+    if (!sv_eq(sv_chop_by_delim(&cache, '\n'), sv_from_cstr(fingerprint))) return_defer(false);
+
+    // NOTE: fire_off_reminders() fires off everything that is scheduled_at <= today, so the cache is valid only strictly before that day
+    String_View next_due = sv_chop_by_delim(&cache, '\n');
+    if (!sv_eq(next_due, sv_from_cstr("-"))) {
+        const char *today = today_local_temp();
+        if (!(strlen(today) == next_due.count && memcmp(today, next_due.data, next_due.count) < 0)) return_defer(false);
+    }
+
+    fwrite(cache.data, 1, cache.count, stdout);
+
+defer:
+    free(sb.items);
+    return result;
+}
+
+// The `daemon` replies to every connection on TORE_DAEMON_SOCKET_PATH with this line followed by the rendered Mailbox
+#define DAEMON_REPLY_MAGIC "tore-daemon "GIT_HASH
+
+bool daemon_socket_addr(struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(TORE_DAEMON_SOCKET_PATH) >= sizeof(addr->sun_path)) return false;
+    strcpy(addr->sun_path, TORE_DAEMON_SOCKET_PATH);
+    return true;
+}
+
+// Returns true and prints the Mailbox if there is a `daemon` running that answered us
+bool checkout_daemon_print(void)
+{
+    bool result = true;
+    String_Builder sb = {0};
+    int fd = -1;
+
+    struct sockaddr_un addr;
+    if (!daemon_socket_addr(&addr)) return_defer(false);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return_defer(false);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) return_defer(false);
+
+    // A stuck daemon must not be able to hang the startup of a shell
+    struct timeval timeout = { .tv_sec = 1 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char buffer[4096];
+    ssize_t n = 0;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) sb_append_buf(&sb, buffer, n);
+    if (n < 0) return_defer(false);
+
+    String_View reply = sb_to_sv(sb);
+    if (!sv_eq(sv_chop_by_delim(&reply, '\n'), sv_from_cstr(DAEMON_REPLY_MAGIC))) return_defer(false);
+    fwrite(reply.data, 1, reply.count, stdout);
+
+defer:
+    if (fd >= 0) close(fd);
+    free(sb.items);
+    return result;
+}
+
+typedef struct Command {
+    const char *name;
+    const char *description;
+    const char *signature;      // NULL means no signature
+    bool (*run)(struct Command *self, const char *program_name, int argc, char **argv);
+} Command;
+
+typedef enum {
+    DESCRIPTION_SHORT,
+    DESCRIPTION_FULL,
+} Description_Type;
+
+void command_describe(Command command, const char *program_name, int pad, Description_Type description_type)
+{
+    printf("%*s%s %s", pad, "", program_name, command.name);
+    if (command.signature) printf(" %s", command.signature);
+    printf("\n");
+    if (command.description) {
+        switch (description_type) {
+        case DESCRIPTION_SHORT: {
+            String_View description = sv_from_cstr(command.description);
+            String_View short_description = sv_chop_by_delim(&description, '\n');
+            printf("%*s    "SV_Fmt"\n", pad, "", SV_Arg(short_description));
+            if (sv_trim(description).count != 0)
+            printf("%*s    ...\n", pad + 2, "");
+        } break;
+        case DESCRIPTION_FULL: {
+            String_View description = sv_from_cstr(command.description);
+            while (description.count > 0) {
+                String_View line = sv_chop_by_delim(&description, '\n');
+                printf("%*s    "SV_Fmt"\n", pad, "", SV_Arg(line));
+            }
         } break;
         default: UNREACHABLE("description_type");
         }
@@ -1014,18 +1988,27 @@ bool checkout_run(Command *self, const char *program_name, int argc, char **argv
     UNUSED(argc);
     UNUSED(argv);
     bool result = true;
-    sqlite3 *db = open_tore_db();
+    sqlite3 *db = NULL;
+    Checkout_Cache cc = {0};
+
+    if (checkout_daemon_print()) return_defer(true);
+    if (checkout_cache_print()) return_defer(true);
+
+    db = open_tore_db();
     if (!db) return_defer(false);
-    if (!txn_begin(db)) return_defer(false);
+    if (!txn_begin_write(db)) return_defer(false);
     if (!fire_off_reminders(db)) return_defer(false);
-    if (!show_active_notifications(db)) return_defer(false);
+    if (!checkout_cache_prepare(db, &cc)) return_defer(false);
+    fwrite(cc.mailbox.items, 1, cc.mailbox.count, stdout);
     // TODO: show reminders that are about to fire off
     //   Maybe they should fire off a "warning" notification before doing the main one?
 defer:
     if (db) {
         if (result) result = txn_commit(db);
-        sqlite3_close(db);
+        if (result) UNUSED(checkout_cache_save(db, &cc));
+        close_tore_db(db);
     }
+    free(cc.mailbox.items);
     return result;
 }
 
@@ -1033,6 +2016,7 @@ bool noti_dismiss_run(Command *self, const char *program_name, int argc, char **
 {
     bool result = true;
     sqlite3 *db = NULL;
+    Checkout_Cache cc = {0};
     if (argc <= 0) {
         fprintf(stderr, "Usage:\n");
         command_describe(*self, program_name, 2, DESCRIPTION_SHORT);
@@ -1042,27 +2026,406 @@ bool noti_dismiss_run(Command *self, const char *program_name, int argc, char **
 
     db = open_tore_db();
     if (!db) return_defer(false);
-    if (!txn_begin(db)) return_defer(false);
+    if (!txn_begin_write(db)) return_defer(false);
 
     int how_many_dismissed = 0;
     if (!dismiss_grouped_notifications_by_indices_from_args(db, &how_many_dismissed, argc, argv)) return_defer(false);
+    if (!checkout_cache_prepare(db, &cc)) return_defer(false);
     if (!show_active_notifications(db)) return_defer(false);
     printf("Dismissed %d notifications\n", how_many_dismissed);
 defer:
     if (db) {
         if (result) result = txn_commit(db);
-        sqlite3_close(db);
+        if (result) UNUSED(checkout_cache_save(db, &cc));
+        close_tore_db(db);
     }
+    free(cc.mailbox.items);
     return result;
 }
 
+#define HTTP_MAX_HEAD_SIZE (8*1024)
+#define HTTP_MAX_HEADERS 32
+
+typedef struct {
+    String_View name;
+    String_View value;
+} Http_Header;
+
+// Parsed request head. All the String_Views point into the Serve_Connection's request buffer.
+typedef struct {
+    String_View method;
+    String_View target;     // The request target exactly as it was sent: <path>?<query>
+    String_View path;
+    String_View query;      // Without the leading '?'. Empty if there is none.
+    String_View version;
+    Http_Header headers[HTTP_MAX_HEADERS];
+    size_t headers_count;
+    bool keep_alive;        // Whether the client wants the connection to stay open after the response
+} Http_Request;
+
+// Whether the comma separated list of the header value contains the token (case-insensitive)
+bool http_value_has_token(String_View value, const char *token)
+{
+    String_View token_sv = sv_from_cstr(token);
+    while (value.count > 0) {
+        String_View item = sv_trim(sv_chop_by_delim(&value, ','));
+        if (item.count == token_sv.count && strncasecmp(item.data, token_sv.data, token_sv.count) == 0) return true;
+    }
+    return false;
+}
+
+// Returns true if the request contains a header with the given name (case-insensitive)
+// and its value contains the given token (case-insensitive)
+bool http_request_has_token(const Http_Request *request, const char *name, const char *token)
+{
+    size_t name_len = strlen(name);
+    for (size_t i = 0; i < request->headers_count; ++i) {
+        String_View header_name = request->headers[i].name;
+        if (header_name.count != name_len || strncasecmp(header_name.data, name, name_len) != 0) continue;
+        if (http_value_has_token(request->headers[i].value, token)) return true;
+    }
+    return false;
+}
+
+// The Connection header of the response, including the line break. HTTP/1.1 connections are persistent unless
+// the response says otherwise, but an HTTP/1.0 client that asked for keep-alive still closes the connection
+// unless the response says keep-alive as well (RFC 7230, section 6.3).
+const char *http_connection_header(const Http_Request *request, bool keep_alive)
+{
+    if (!keep_alive) return "Connection: close\r\n";
+    if (!sv_eq(request->version, sv_from_cstr("HTTP/1.1"))) return "Connection: keep-alive\r\n";
+    return "";
+}
+
+// Whether the quality value in the parameters of a list item (like ";q=0.5") is 0, which means "not acceptable"
+bool http_params_reject(String_View params)
+{
+    while (params.count > 0) {
+        String_View param = sv_trim(sv_chop_by_delim(&params, ';'));
+        if (param.count < 2 || tolower(param.data[0]) != 'q' || param.data[1] != '=') continue;
+        String_View qvalue = sv_from_parts(param.data + 2, param.count - 2);
+        if (qvalue.count == 0) return false;
+        for (size_t i = 0; i < qvalue.count; ++i) {
+            if (qvalue.data[i] != '0' && qvalue.data[i] != '.') return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+// Whether the client accepts the content coding according to its Accept-Encoding headers (RFC 9110, 12.5.3)
+bool http_accepts_encoding(const Http_Request *request, const char *coding)
+{
+    size_t coding_len = strlen(coding);
+    bool listed = false, accepted = false, star = false;
+    for (size_t i = 0; i < request->headers_count; ++i) {
+        String_View name = request->headers[i].name;
+        if (name.count != strlen("Accept-Encoding") || strncasecmp(name.data, "Accept-Encoding", name.count) != 0) continue;
+        String_View value = request->headers[i].value;
+        while (value.count > 0) {
+            String_View item = sv_trim(sv_chop_by_delim(&value, ','));
+            String_View item_coding = sv_trim(sv_chop_by_delim(&item, ';'));
+            if (item_coding.count == coding_len && strncasecmp(item_coding.data, coding, coding_len) == 0) {
+                listed = true;
+                accepted = !http_params_reject(item);
+            } else if (sv_eq(item_coding, sv_from_cstr("*"))) {
+                star = !http_params_reject(item);
+            }
+        }
+    }
+    return listed ? accepted : star;
+}
+
+// Whether any of the If-None-Match headers matches the etag. If-None-Match uses the weak comparison,
+// so the W/ prefixes are ignored (RFC 9110, 13.1.2).
+bool http_etag_matches(const Http_Request *request, const char *etag)
+{
+    String_View etag_sv = sv_from_cstr(etag);
+    if (sv_starts_with(etag_sv, sv_from_cstr("W/"))) sv_chop_left(&etag_sv, 2);
+    for (size_t i = 0; i < request->headers_count; ++i) {
+        String_View name = request->headers[i].name;
+        if (name.count != strlen("If-None-Match") || strncasecmp(name.data, "If-None-Match", name.count) != 0) continue;
+        String_View value = request->headers[i].value;
+        while (value.count > 0) {
+            String_View item = sv_trim(sv_chop_by_delim(&value, ','));
+            if (sv_eq(item, sv_from_cstr("*"))) return true;
+            if (sv_starts_with(item, sv_from_cstr("W/"))) sv_chop_left(&item, 2);
+            if (sv_eq(item, etag_sv)) return true;
+        }
+    }
+    return false;
+}
+
+int http_hex_digit(char c)
+{
+    if ('0' <= c && c <= '9') return c - '0';
+    if ('a' <= c && c <= 'f') return c - 'a' + 10;
+    if ('A' <= c && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Looks for the parameter in the query string and percent-decodes its value into the buffer.
+// Returns 1 if found, 0 if there is no such parameter and -1 if the value is malformed or does not fit.
+int http_query_param(String_View query, const char *name, char *buf, size_t size)
+{
+    while (query.count > 0) {
+        String_View value = sv_chop_by_delim(&query, '&');
+        String_View param = sv_chop_by_delim(&value, '=');
+        if (!sv_eq(param, sv_from_cstr(name))) continue;
+        size_t n = 0;
+        for (size_t i = 0; i < value.count; ++i) {
+            char c = value.data[i];
+            if (c == '+') {
+                c = ' ';
+            } else if (c == '%') {
+                if (i + 2 >= value.count) return -1;
+                int hi = http_hex_digit(value.data[i + 1]);
+                int lo = http_hex_digit(value.data[i + 2]);
+                if (hi < 0 || lo < 0) return -1;
+                c = hi*16 + lo;
+                i += 2;
+            }
+            if (n + 1 >= size) return -1;
+            buf[n++] = c;
+        }
+        buf[n] = '\0';
+        return 1;
+    }
+    return 0;
+}
+
+bool page_cursor_parse(const char *cstr, Page_Cursor *cursor)
+{
+    const char *colon = strrchr(cstr, ':');
+    if (colon == NULL) return false;
+    size_t key_len = colon - cstr;
+    if (key_len == 0 || key_len >= sizeof(cursor->key)) return false;
+    for (size_t i = 0; i < key_len; ++i) {
+        if (!isdigit(cstr[i]) && cstr[i] != '-') return false;
+    }
+    char *endptr = NULL;
+    long id = strtol(colon + 1, &endptr, 10);
+    if (endptr == colon + 1 || *endptr != '\0' || id < INT_MIN || id > INT_MAX) return false;
+    memcpy(cursor->key, cstr, key_len);
+    cursor->key[key_len] = '\0';
+    cursor->id = id;
+    cursor->present = true;
+    return true;
+}
+
+void sb_append_page_cursor(String_Builder *sb, Page_Cursor cursor)
+{
+    sb_append_cstr(sb, cursor.key);
+    da_append(sb, ':');
+    sb_append_int(sb, cursor.id);
+}
+
+bool page_query_parse(String_View query, Page_Query *page)
+{
+    char value[64];
+    *page = (Page_Query) { .limit = PAGE_DEFAULT_LIMIT };
+
+    int ret = http_query_param(query, "limit", value, sizeof(value));
+    if (ret < 0) return false;
+    if (ret > 0) {
+        char *endptr = NULL;
+        unsigned long limit = strtoul(value, &endptr, 10);
+        if (endptr == value || *endptr != '\0' || limit == 0) return false;
+        page->limit = limit < PAGE_MAX_LIMIT ? limit : PAGE_MAX_LIMIT;
+    }
+
+    ret = http_query_param(query, "after", value, sizeof(value));
+    if (ret < 0 || (ret > 0 && !page_cursor_parse(value, &page->after))) return false;
+
+    ret = http_query_param(query, "reminders_after", value, sizeof(value));
+    if (ret < 0 || (ret > 0 && !page_cursor_parse(value, &page->reminders_after))) return false;
+
+    return true;
+}
+
+// Responses that are queued for sending. The rendered bytes are accumulated in `owned`, while the bytes
+// that live as long as the process (like the bundle) are referenced directly, so the whole queue goes out
+// with writev() without copying them anywhere.
+typedef struct {
+    const char *data;   // NULL means the segment is at `offset` in Serve_Output.owned, which may be reallocated
+    size_t offset;
+    size_t size;
+} Serve_Segment;
+
+typedef struct {
+    Serve_Segment *items;
+    size_t count;
+    size_t capacity;
+    String_Builder owned;
+    size_t sealed;          // How many bytes of `owned` are already covered by the segments
+    size_t sent_segments;   // How many segments are completely sent
+    size_t sent_bytes;      // How many bytes of the first not completely sent segment are sent
+} Serve_Output;
+
+// Turns everything that was appended to `owned` since the last call into a segment
+void output_seal(Serve_Output *out)
+{
+    if (out->owned.count > out->sealed) {
+        da_append(out, ((Serve_Segment) {
+            .offset = out->sealed,
+            .size = out->owned.count - out->sealed,
+        }));
+        out->sealed = out->owned.count;
+    }
+}
+
+// The data must outlive the connection
+void output_append_static(Serve_Output *out, const void *data, size_t size)
+{
+    if (size == 0) return;
+    output_seal(out);
+    da_append(out, ((Serve_Segment) {
+        .data = data,
+        .size = size,
+    }));
+}
+
+bool output_pending(Serve_Output *out)
+{
+    return out->count > 0 || out->owned.count > out->sealed;
+}
+
+void output_reset(Serve_Output *out)
+{
+    out->count = 0;
+    out->owned.count = 0;
+    out->sealed = 0;
+    out->sent_segments = 0;
+    out->sent_bytes = 0;
+}
+
+// The index page of a big mailbox may be streamed straight into the client socket instead of being
+// rendered into Serve_Output first. The head goes out before the database is even queried and the
+// body follows in chunks of Transfer-Encoding: chunked, so only one chunk is in memory at a time.
+// The worker never waits for the client though. As soon as the socket would block, the rest of the
+// page is spilled into Serve_Output like a regular response and the event loop sends it whenever the
+// client is ready, so the clients that stop reading can't take the workers hostage.
+#define SERVE_STREAM_CHUNK_SIZE (16*1024)
+
+typedef struct {
+    int fd;
+    Serve_Output *spill;    // The output of the connection, where everything goes once the socket would block
+    String_Builder chunk;   // Rendered, but not sent yet
+    bool failed;            // The client is gone, so everything else is dropped
+} Serve_Stream;
+
+void serve_stream_write(Serve_Stream *stream, struct iovec *iov, int iovcnt)
+{
+    if (stream->failed) return;
+    // Once something is spilled the order must be preserved, so everything else follows it
+    while (iovcnt > 0 && !output_pending(stream->spill)) {
+        ssize_t n = writev(stream->fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            fprintf(stderr, "ERROR: Could not write response: %s\n", strerror(errno));
+            stream->failed = true;
+            return;
+        }
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov += 1;
+            iovcnt -= 1;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    for (int i = 0; i < iovcnt; ++i) {
+        sb_append_buf(&stream->spill->owned, iov[i].iov_base, iov[i].iov_len);
+    }
+}
+
+void serve_stream_reset(Serve_Stream *stream, int fd, Serve_Output *spill)
+{
+    stream->fd = fd;
+    stream->spill = spill;
+    stream->chunk.count = 0;
+    stream->failed = false;
+}
+
+bool serve_stream_flush(Serve_Stream *stream)
+{
+    if (!stream->failed && stream->chunk.count > 0) {
+        char size[32];
+        int size_len = snprintf(size, sizeof(size), "%zx\r\n", stream->chunk.count);
+        struct iovec iov[] = {
+            { .iov_base = size,                .iov_len = size_len },
+            { .iov_base = stream->chunk.items, .iov_len = stream->chunk.count },
+            { .iov_base = "\r\n",              .iov_len = 2 },
+        };
+        serve_stream_write(stream, iov, ARRAY_LEN(iov));
+    }
+    stream->chunk.count = 0;
+    return !stream->failed;
+}
+
+// Sends the chunk as soon as it's big enough
+void serve_stream_pump(Serve_Stream *stream)
+{
+    if (stream->chunk.count >= SERVE_STREAM_CHUNK_SIZE) UNUSED(serve_stream_flush(stream));
+}
+
+bool serve_stream_begin(Serve_Stream *stream, const char *etag, const char *connection)
+{
+    String_Builder *head = &stream->chunk;
+    sb_append_cstr(head, "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nTransfer-Encoding: chunked\r\n");
+    if (etag) {
+        sb_append_cstr(head, "ETag: ");
+        sb_append_cstr(head, etag);
+        sb_append_cstr(head, "\r\nCache-Control: no-cache\r\n");
+    }
+    sb_append_cstr(head, connection);
+    sb_append_cstr(head, "\r\n");
+    struct iovec iov = { .iov_base = head->items, .iov_len = head->count };
+    serve_stream_write(stream, &iov, 1);
+    head->count = 0;
+    return !stream->failed;
+}
+
+bool serve_stream_finish(Serve_Stream *stream)
+{
+    if (!serve_stream_flush(stream)) return false;
+    struct iovec iov = { .iov_base = "0\r\n\r\n", .iov_len = 5 };
+    serve_stream_write(stream, &iov, 1);
+    return !stream->failed;
+}
+
+void render_index_page_streamed(Serve_Stream *stream, Grouped_Notifications notifs, Reminders reminders, const char *notifs_more, const char *reminders_more)
+{
+    String_Builder *sb = &stream->chunk;
+#define OUT(buf, size) sb_append_buf(sb, buf, size); serve_stream_pump(stream);
+#define TEMPLATE_STATIC_BYTES(n)
+#define ESCAPED(cstr) sb_append_html_escaped_buf(sb, cstr, strlen(cstr)); serve_stream_pump(stream);
+#define INT(x) sb_append_int(sb, (x));
+#define PAGE_BODY "index_page.h"
+#define PAGE_TITLE
+#include "root_page.h"
+#undef PAGE_TITLE
+#undef PAGE_BODY
+#undef TEMPLATE_STATIC_BYTES
+#undef INT
+#undef ESCAPED
+#undef OUT
+}
+
 typedef struct {
-    int client_fd;
+    sqlite3 *db;    // Long-lived connection owned by a worker thread, so the requests only bind/step/reset cached statements. NULL in the event loop.
+    Arena arena;    // Scratch memory of the worker thread
+    bool keep_alive;            // Whether the connection stays open after the response to the current request
     Grouped_Notifications notifs;
     Reminders reminders;
-    String_Builder request;
-    String_Builder response;
     String_Builder body;
+    const Http_Request *request;  // The current request. Owned by the Serve_Connection.
+    const char *etag;           // ETag of the current dynamic page or NULL. Owned by the Serve_Connection.
+    Serve_Output *out;          // Where the response to the current request is rendered to. Owned by the Serve_Connection.
+    Serve_Stream *stream;       // Non-NULL if the current page goes straight into the client socket instead of `out`
 } Serve_Context;
 
 void sc_reset(Serve_Context *sc)
@@ -1070,18 +2433,21 @@ void sc_reset(Serve_Context *sc)
     sc->notifs.count = 0;
     sc->reminders.count = 0;
     sc->body.count = 0;
-    sc->response.count = 0;
-    sc->request.count = 0;
+    arena_reset(&sc->arena);
 }
 
-Resource *find_resource(const char *file_path)
+const char *serve_connection_header(const Serve_Context *sc)
 {
-    for (size_t i = 0; i < resources_count; ++i) {
-        if (strcmp(file_path, resources[i].file_path) == 0) {
-            return &resources[i];
-        }
-    }
-    return NULL;
+    return http_connection_header(sc->request, sc->keep_alive);
+}
+
+void sc_free(Serve_Context *sc)
+{
+    if (sc->db) close_tore_db(sc->db);
+    arena_free(&sc->arena);
+    free(sc->body.items);
+    free(sc->notifs.items);
+    free(sc->reminders.items);
 }
 
 bool write_entire_sv(int fd, String_View sv)
@@ -1175,60 +2541,321 @@ const char *http_reason_phrase_by_status_code(int status_code)
     return reason_phrases[status_code];
 }
 
-void http_render_response(String_Builder *response, int status_code, const char *content_type, String_View body)
+// The responses with an etag are cached by the browsers, but revalidated on every use
+void http_render_response(Serve_Output *out, int status_code, const char *content_type, const char *etag, const char *connection, String_View body)
 {
-    sb_append_cstr(response, temp_sprintf("HTTP/1.0 %d %s\r\n", status_code, http_reason_phrase_by_status_code(status_code)));
-    sb_append_cstr(response, temp_sprintf("Content-Type: %s\r\n", content_type));
-    sb_append_cstr(response, temp_sprintf("Content-Length: %zu\r\n", body.count));
-    sb_append_cstr(response, "Connection: close\r\n");
+    String_Builder *response = &out->owned;
+    sb_append_cstr(response, "HTTP/1.1 ");
+    sb_append_int(response, status_code);
+    sb_append_cstr(response, " ");
+    sb_append_cstr(response, http_reason_phrase_by_status_code(status_code));
+    sb_append_cstr(response, "\r\nContent-Type: ");
+    sb_append_cstr(response, content_type);
+    sb_append_cstr(response, "\r\nContent-Length: ");
+    sb_append_size(response, body.count);
+    sb_append_cstr(response, "\r\n");
+    if (etag) {
+        sb_append_cstr(response, "ETag: ");
+        sb_append_cstr(response, etag);
+        sb_append_cstr(response, "\r\nCache-Control: no-cache\r\n");
+    }
+    sb_append_cstr(response, connection);
     sb_append_cstr(response, "\r\n");
     sb_append_buf(response, body.data, body.count);
 }
 
+void http_render_not_modified(Serve_Output *out, const char *etag, const char *cache_control, bool vary, const char *connection)
+{
+    String_Builder *response = &out->owned;
+    sb_append_cstr(response, "HTTP/1.1 304 Not Modified\r\n");
+    sb_append_cstr(response, "ETag: ");
+    sb_append_cstr(response, etag);
+    sb_append_cstr(response, "\r\nCache-Control: ");
+    sb_append_cstr(response, cache_control);
+    sb_append_cstr(response, "\r\n");
+    if (vary) sb_append_cstr(response, "Vary: Accept-Encoding\r\n");
+    sb_append_cstr(response, connection);
+    sb_append_cstr(response, "\r\n");
+}
+
 void serve_error(Serve_Context *sc, int status_code)
 {
+    sc->body.count = 0;
     render_error_page(&sc->body, status_code, http_reason_phrase_by_status_code(status_code));
-    http_render_response(&sc->response, status_code, "text/html", sb_to_sv(sc->body));
-    UNUSED(write_entire_sv(sc->client_fd, sb_to_sv(sc->response)));
+    http_render_response(sc->out, status_code, "text/html", NULL, serve_connection_header(sc), sb_to_sv(sc->body));
 }
 
-void serve_index(Serve_Context *sc)
+#define PAGE_HREF_CAPACITY 160
+
+// Link to the index page with the given cursors
+void index_page_href(char href[PAGE_HREF_CAPACITY], size_t limit, Page_Cursor after, Page_Cursor reminders_after)
+{
+    int n = snprintf(href, PAGE_HREF_CAPACITY, "/?limit=%zu", limit);
+    if (after.present) {
+        n += snprintf(href + n, PAGE_HREF_CAPACITY - n, "&after=%s:%d", after.key, after.id);
+    }
+    if (reminders_after.present) {
+        snprintf(href + n, PAGE_HREF_CAPACITY - n, "&reminders_after=%s:%d", reminders_after.key, reminders_after.id);
+    }
+}
+
+// Loads a page of both lists of the index page and links to the next ones
+bool load_index_page(Serve_Context *sc, Page_Query page, char notifs_more[PAGE_HREF_CAPACITY], char reminders_more[PAGE_HREF_CAPACITY])
+{
+    Page_Cursor notifs_next = {0};
+    Page_Cursor reminders_next = {0};
+    if (!load_active_grouped_notifications_page(sc->db, page.after, page.limit, &sc->notifs, &notifs_next)) return false;
+    if (!load_active_reminders_page(sc->db, page.reminders_after, page.limit, &sc->reminders, &reminders_next)) return false;
+    notifs_more[0] = '\0';
+    reminders_more[0] = '\0';
+    if (notifs_next.present) index_page_href(notifs_more, page.limit, notifs_next, page.reminders_after);
+    if (reminders_next.present) index_page_href(reminders_more, page.limit, page.after, reminders_next);
+    return true;
+}
+
+void serve_index(Serve_Context *sc, Page_Query page)
 {
     bool result = true;
-    sqlite3 *db = open_tore_db();
-    if (!db) return_defer(false);
-    if (!txn_begin(db)) return_defer(false);
+    bool txn_started = false;
+    if (!txn_begin(sc->db)) {
+        serve_error(sc, 500);
+        return_defer(false);
+    }
+    txn_started = true;
 
-    if (!load_active_grouped_notifications(db, &sc->notifs)) {
+    char notifs_more[PAGE_HREF_CAPACITY];
+    char reminders_more[PAGE_HREF_CAPACITY];
+    if (!load_index_page(sc, page, notifs_more, reminders_more)) {
         serve_error(sc, 500);
         return_defer(false);
     }
 
-    if (!load_active_reminders(db, &sc->reminders)) {
+    render_index_page(&sc->body, sc->notifs, sc->reminders,
+                      notifs_more[0] ? notifs_more : NULL,
+                      reminders_more[0] ? reminders_more : NULL);
+    http_render_response(sc->out, 200, "text/html", sc->etag, serve_connection_header(sc), sb_to_sv(sc->body));
+
+defer:
+    if (txn_started) {
+        if (result) result = txn_commit(sc->db);
+        if (!result) UNUSED(txn_rollback(sc->db));
+    }
+}
+
+void serve_api_error(Serve_Context *sc, int status_code)
+{
+    const char *reason = http_reason_phrase_by_status_code(status_code);
+    sc->body.count = 0;
+    sb_append_cstr(&sc->body, "{\"error\":");
+    sb_append_json_buf(&sc->body, reason, strlen(reason));
+    sb_append_cstr(&sc->body, "}\n");
+    http_render_response(sc->out, status_code, "application/json", NULL, serve_connection_header(sc), sb_to_sv(sc->body));
+}
+
+// {"<name>":[<row>,...],"next":"<cursor>"|null}. The statement yields up to limit + 1 rows.
+bool serve_api_page(Serve_Context *sc, sqlite3_stmt *stmt, const char *name, size_t limit, int json_columns, int key_column, int id_column)
+{
+    String_Builder *sb = &sc->body;
+    sb_append_cstr(sb, "{\"");
+    sb_append_cstr(sb, name);
+    sb_append_cstr(sb, "\":[");
+
+    Page_Cursor last = {0};
+    Page_Cursor next = {0};
+    size_t count = 0;
+    int ret = 0;
+    for (ret = sqlite3_step(stmt); ret == SQLITE_ROW; ret = sqlite3_step(stmt)) {
+        if (count >= limit) {
+            next = last;
+            break;
+        }
+        if (count > 0) da_append(sb, ',');
+        sb_append_json_row(sb, stmt, json_columns);
+        page_cursor_from_row(stmt, key_column, id_column, &last);
+        count += 1;
+    }
+    if (ret != SQLITE_DONE && ret != SQLITE_ROW) {
+        LOG_SQLITE3_ERROR(sqlite3_db_handle(stmt));
+        return false;
+    }
+
+    sb_append_cstr(sb, "],\"next\":");
+    if (next.present) {
+        da_append(sb, '"');
+        sb_append_page_cursor(sb, next);
+        da_append(sb, '"');
+    } else {
+        sb_append_cstr(sb, "null");
+    }
+    sb_append_cstr(sb, "}\n");
+    http_render_response(sc->out, 200, "application/json", sc->etag, serve_connection_header(sc), sb_to_sv(*sb));
+    return true;
+}
+
+void serve_api_notifications(Serve_Context *sc, Page_Query page)
+{
+    bool result = true;
+    bool txn_started = false;
+    sqlite3_stmt *stmt = NULL;
+    if (!txn_begin(sc->db)) {
+        serve_api_error(sc, 500);
+        return_defer(false);
+    }
+    txn_started = true;
+
+    if (!prepare_active_grouped_notifications_page(sc->db, page.after, page.limit, &stmt)) {
+        serve_api_error(sc, 500);
+        return_defer(false);
+    }
+    if (!serve_api_page(sc, stmt, "notifications", page.limit, NOTIFS_PAGE_JSON_COLUMNS, NOTIFS_PAGE_KEY_COLUMN, NOTIFS_PAGE_ID_COLUMN)) {
+        serve_api_error(sc, 500);
+        return_defer(false);
+    }
+
+defer:
+    if (stmt) stmt_release(stmt);
+    if (txn_started) {
+        if (result) result = txn_commit(sc->db);
+        if (!result) UNUSED(txn_rollback(sc->db));
+    }
+}
+
+void serve_api_reminders(Serve_Context *sc, Page_Query page)
+{
+    bool result = true;
+    bool txn_started = false;
+    sqlite3_stmt *stmt = NULL;
+    if (!txn_begin(sc->db)) {
+        serve_api_error(sc, 500);
+        return_defer(false);
+    }
+    txn_started = true;
+
+    if (!prepare_active_reminders_page(sc->db, page.after, page.limit, &stmt)) {
+        serve_api_error(sc, 500);
+        return_defer(false);
+    }
+    if (!serve_api_page(sc, stmt, "reminders", page.limit, REMINDERS_PAGE_JSON_COLUMNS, REMINDERS_PAGE_KEY_COLUMN, REMINDERS_PAGE_ID_COLUMN)) {
+        serve_api_error(sc, 500);
+        return_defer(false);
+    }
+
+defer:
+    if (stmt) stmt_release(stmt);
+    if (txn_started) {
+        if (result) result = txn_commit(sc->db);
+        if (!result) UNUSED(txn_rollback(sc->db));
+    }
+}
+
+// Serves the single row of the statement as a JSON object or 404 if there is none
+void serve_api_row(Serve_Context *sc, sqlite3_stmt *stmt)
+{
+    int ret = sqlite3_step(stmt);
+    if (ret == SQLITE_DONE) {
+        serve_api_error(sc, 404);
+        return;
+    }
+    if (ret != SQLITE_ROW) {
+        LOG_SQLITE3_ERROR(sqlite3_db_handle(stmt));
+        serve_api_error(sc, 500);
+        return;
+    }
+    sb_append_json_row(&sc->body, stmt, sqlite3_column_count(stmt));
+    da_append(&sc->body, '\n');
+    http_render_response(sc->out, 200, "application/json", sc->etag, serve_connection_header(sc), sb_to_sv(sc->body));
+}
+
+void serve_api_notif(Serve_Context *sc, int notif_id)
+{
+    sqlite3_stmt *stmt = NULL;
+    int ret = stmt_prepare(sc->db,
+        "SELECT\n"
+        "    id,\n"
+        "    title,\n"
+        "    datetime(created_at, 'localtime') AS created_at,\n"
+        "    datetime(dismissed_at, 'localtime') AS dismissed_at,\n"
+        "    reminder_id,\n"
+        "    ifnull(reminder_id, -id) AS group_id\n"
+        "FROM Notifications WHERE id = ?;",
+        &stmt);
+    if (ret != SQLITE_OK || sqlite3_bind_int(stmt, 1, notif_id) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(sc->db);
+        serve_api_error(sc, 500);
+    } else {
+        serve_api_row(sc, stmt);
+    }
+    if (stmt) stmt_release(stmt);
+}
+
+// Cheap enough to be polled by status bars. Every count is a scan of a partial index of the active rows.
+void serve_api_stats(Serve_Context *sc)
+{
+    sqlite3_stmt *stmt = NULL;
+    int ret = stmt_prepare(sc->db,
+        "SELECT\n"
+        "    (SELECT count(*) FROM Notifications WHERE dismissed_at IS NULL) AS active_notifications,\n"
+        "    (SELECT count(DISTINCT ifnull(reminder_id, -id)) FROM Notifications WHERE dismissed_at IS NULL) AS active_groups,\n"
+        "    (SELECT count(*) FROM Reminders WHERE finished_at IS NULL) AS active_reminders,\n"
+        "    (SELECT min(scheduled_at) FROM Reminders WHERE finished_at IS NULL) AS next_scheduled_at;",
+        &stmt);
+    if (ret != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(sc->db);
+        serve_api_error(sc, 500);
+    } else {
+        serve_api_row(sc, stmt);
+    }
+    if (stmt) stmt_release(stmt);
+}
+
+void serve_index_streamed(Serve_Context *sc, Page_Query page)
+{
+    bool result = true;
+    bool txn_started = false;
+    if (!txn_begin(sc->db)) {
         serve_error(sc, 500);
         return_defer(false);
     }
+    txn_started = true;
 
-    render_index_page(&sc->body, sc->notifs, sc->reminders);
-    http_render_response(&sc->response, 200, "text/html", sb_to_sv(sc->body));
-    UNUSED(write_entire_sv(sc->client_fd, sb_to_sv(sc->response)));
+    if (!serve_stream_begin(sc->stream, sc->etag, serve_connection_header(sc))) {
+        sc->keep_alive = false;
+        return_defer(false);
+    }
+
+    // It's too late for a 500 at this point. Closing the connection without the last chunk at least
+    // tells the client that the response is incomplete.
+    char notifs_more[PAGE_HREF_CAPACITY];
+    char reminders_more[PAGE_HREF_CAPACITY];
+    if (!load_index_page(sc, page, notifs_more, reminders_more)) {
+        sc->keep_alive = false;
+        return_defer(false);
+    }
+
+    render_index_page_streamed(sc->stream, sc->notifs, sc->reminders,
+                               notifs_more[0] ? notifs_more : NULL,
+                               reminders_more[0] ? reminders_more : NULL);
+    if (!serve_stream_finish(sc->stream)) sc->keep_alive = false;
 
 defer:
-    if (db) {
-        if (result) result = txn_commit(db);
-        sqlite3_close(db);
+    if (txn_started) {
+        if (result) result = txn_commit(sc->db);
+        if (!result) UNUSED(txn_rollback(sc->db));
     }
 }
 
 bool serve_notif(Serve_Context *sc, int notif_id)
 {
     bool result = true;
-    sqlite3 *db = open_tore_db();
-    if (!db) return_defer(false);
-    if (!txn_begin(db)) return_defer(false);
+    bool txn_started = false;
+    if (!txn_begin(sc->db)) {
+        serve_error(sc, 500);
+        return_defer(false);
+    }
+    txn_started = true;
 
     Notification notif = {0};
-    int ret = load_notification_by_id(db, notif_id, &notif);
+    int ret = load_notification_by_id(sc->db, notif_id, &notif);
     if (ret < 0) {
         // something failed during request
         serve_error(sc, 500);
@@ -1241,12 +2868,11 @@ bool serve_notif(Serve_Context *sc, int notif_id)
     }
 
     render_notif_page(&sc->body, notif);
-    http_render_response(&sc->response, 200, "text/html", sb_to_sv(sc->body));
-    UNUSED(write_entire_sv(sc->client_fd, sb_to_sv(sc->response)));
+    http_render_response(sc->out, 200, "text/html", sc->etag, serve_connection_header(sc), sb_to_sv(sc->body));
 defer:
-    if (db) {
-        if (result) result = txn_commit(db);
-        sqlite3_close(db);
+    if (txn_started) {
+        if (result) result = txn_commit(sc->db);
+        if (!result) UNUSED(txn_rollback(sc->db));
     }
     return result;
 }
@@ -1254,179 +2880,1343 @@ defer:
 void serve_version(Serve_Context *sc)
 {
     render_version_page(&sc->body);
-    http_render_response(&sc->response, 200, "text/html", sb_to_sv(sc->body));
-    UNUSED(write_entire_sv(sc->client_fd, sb_to_sv(sc->response)));
+    http_render_response(sc->out, 200, "text/html", NULL, serve_connection_header(sc), sb_to_sv(sc->body));
 }
 
-void serve_resource(Serve_Context *sc, const char *resource_path, const char *content_type)
+// The head of the response is pre-rendered by nob.c, so both the head and the body are sent straight from bundle[]
+void serve_resource(Serve_Context *sc, Resource *resource)
 {
-    Resource *resource = find_resource(resource_path);
-    if (!resource) {
-        serve_error(sc, 404);
+    // The compressed variants are produced at build time, so serving them costs nothing
+    Resource_Variant *variant = &resource->identity;
+    if (resource->gzip.size > 0 && http_accepts_encoding(sc->request, "gzip")) variant = &resource->gzip;
+
+    if (http_etag_matches(sc->request, variant->etag)) {
+        http_render_not_modified(sc->out, variant->etag, RESOURCE_CACHE_CONTROL, resource->gzip.size > 0, serve_connection_header(sc));
         return;
     }
 
-    sb_append_buf(&sc->body, &bundle[resource->offset], resource->size);
-    http_render_response(&sc->response, 200, content_type, sb_to_sv(sc->body));
-    UNUSED(write_entire_sv(sc->client_fd, sb_to_sv(sc->response)));
-}
+    const char *connection = serve_connection_header(sc);
+    output_append_static(sc->out, &bundle[variant->head_offset], variant->head_size);
+    output_append_static(sc->out, connection, strlen(connection));
+    output_append_static(sc->out, "\r\n", 2);
+    output_append_static(sc->out, &bundle[variant->offset], variant->size);
+}
+
+// Looks for the \r\n\r\n that ends the request head. Resumes from *scanned where the previous call
+// on the same buffer stopped, so the bytes are looked at only once no matter how many reads it takes
+// for the head to arrive. Returns the size of the head or 0 if it's not complete yet.
+size_t http_scan_head(const char *buf, size_t count, size_t *scanned)
+{
+    size_t i = *scanned;
+    while (i < count) {
+        // memchr() is vectorized by libc, which is as good as we can get without rolling our own SIMD
+        const char *lf = memchr(buf + i, '\n', count - i);
+        if (lf == NULL) break;
+        i = lf - buf + 1;
+        if (i >= 4 && memcmp(lf - 3, "\r\n\r\n", 4) == 0) {
+            *scanned = i;
+            return i;
+        }
+    }
+    *scanned = count;
+    return 0;
+}
+
+String_View http_chop_line(String_View *sv)
+{
+    const char *lf = memchr(sv->data, '\n', sv->count);
+    size_t n = lf ? (size_t)(lf - sv->data) : sv->count;
+    String_View line = sv_from_parts(sv->data, n);
+    sv->data  += lf ? n + 1 : n;
+    sv->count -= lf ? n + 1 : n;
+    if (line.count > 0 && line.data[line.count - 1] == '\r') line.count -= 1;
+    return line;
+}
+
+// Parses the complete head found by http_scan_head(). Returns 0 on success or the status code the
+// request has to be rejected with.
+int http_parse_request_head(String_View head, Http_Request *request)
+{
+    request->headers_count = 0;
+    request->keep_alive = false;
+
+    // <Method> <Target> <Version>\r\n<Header>\r\n<Header>\r\n<Header>\r\n\r\n
+    String_View request_line = http_chop_line(&head);
+    request->method = sv_chop_by_delim(&request_line, ' ');
+    request->target = sv_chop_by_delim(&request_line, ' ');
+    request->version = request_line;
+    if (request->method.count == 0 || request->target.count == 0 || !sv_starts_with(request->version, sv_from_cstr("HTTP/"))) {
+        return 400;
+    }
+
+    const char *question = memchr(request->target.data, '?', request->target.count);
+    if (question) {
+        request->path = sv_from_parts(request->target.data, question - request->target.data);
+        request->query = sv_from_parts(question + 1, request->target.count - request->path.count - 1);
+    } else {
+        request->path = request->target;
+        request->query = sv_from_parts(request->target.data + request->target.count, 0);
+    }
+
+    for (;;) {
+        String_View line = http_chop_line(&head);
+        if (line.count == 0) break;
+        if (request->headers_count >= HTTP_MAX_HEADERS) return 431;
+        const char *colon = memchr(line.data, ':', line.count);
+        if (colon == NULL || colon == line.data) return 400;
+        Http_Header *header = &request->headers[request->headers_count++];
+        header->name = sv_from_parts(line.data, colon - line.data);
+        header->value = sv_trim(sv_from_parts(colon + 1, line.count - header->name.count - 1));
+    }
+
+    // HTTP/1.1 connections are persistent by default, HTTP/1.0 ones have to ask for it explicitly
+    if (sv_eq(request->version, sv_from_cstr("HTTP/1.1"))) {
+        request->keep_alive = !http_request_has_token(request, "Connection", "close");
+    } else {
+        request->keep_alive = http_request_has_token(request, "Connection", "keep-alive");
+    }
+    return 0;
+}
+
+typedef enum {
+    ROUTE_ERROR,
+    ROUTE_NOT_MODIFIED,     // The client already has the current version of a dynamic page
+    ROUTE_INDEX,
+    ROUTE_VERSION,
+    ROUTE_RESOURCE,
+    ROUTE_NOTIF,
+    ROUTE_API_NOTIFICATIONS,
+    ROUTE_API_NOTIF,
+    ROUTE_API_REMINDERS,
+    ROUTE_API_STATS,
+    ROUTE_EVENTS,           // Served by the event loop itself, since the connection is held open there
+} Route_Kind;
+
+// Generated by nob.c: a perfect hash table of the fixed routes (including every bundled resource)
+// and a prefix trie of the routes with parameters
+#include "routes.h"
+
+typedef struct {
+    Route_Kind kind;
+    int status_code;            // ROUTE_ERROR
+    bool close;                 // ROUTE_ERROR: the rest of the connection can't be trusted to be a valid request stream
+    Resource *resource;         // ROUTE_RESOURCE
+    int notif_id;               // ROUTE_NOTIF, ROUTE_API_NOTIF
+    Page_Query page;            // ROUTE_INDEX, ROUTE_API_NOTIFICATIONS, ROUTE_API_REMINDERS
+} Route;
+
+Route route_error(int status_code, bool close)
+{
+    return (Route) { .kind = ROUTE_ERROR, .status_code = status_code, .close = close };
+}
+
+const Route_Entry *route_lookup(String_View path)
+{
+    const Route_Entry *entry = &route_table[route_hash(path.data, path.count, ROUTE_HASH_SEED) & (ROUTE_TABLE_SIZE - 1)];
+    if (entry->path == NULL) return NULL;
+    if (entry->path_len != path.count) return NULL;
+    if (memcmp(entry->path, path.data, path.count) != 0) return NULL;
+    return entry;
+}
+
+// Returns the longest prefix route that matches the path or NULL
+const Route_Prefix *route_match_prefix(String_View path)
+{
+    const Route_Prefix *match = NULL;
+    int node = 0;
+    for (size_t i = 0; i < path.count; ++i) {
+        int child = route_trie[node].first_child;
+        while (child >= 0 && route_trie[child].byte != (unsigned char)path.data[i]) {
+            child = route_trie[child].next_sibling;
+        }
+        if (child < 0) break;
+        node = child;
+        if (route_trie[node].prefix >= 0) match = &route_prefixes[route_trie[node].prefix];
+    }
+    return match;
+}
+
+Route route_request(const Http_Request *request)
+{
+    // TODO: should `serve` fire off reminders?
+    // TODO: log HTTP queries
+
+    // We never read request bodies, so anything that may have one would desync the pipelined requests
+    if (!sv_eq(request->method, sv_from_cstr("GET"))) {
+        return route_error(405, true);
+    }
+
+    String_View path = request->path;
+    const Route_Entry *entry = route_lookup(path);
+    if (entry) {
+        switch (entry->kind) {
+        case ROUTE_ERROR:
+            return route_error(entry->status_code, false);
+        case ROUTE_RESOURCE:
+            return (Route) { .kind = ROUTE_RESOURCE, .resource = &resources[entry->resource] };
+        case ROUTE_INDEX:
+        case ROUTE_API_NOTIFICATIONS:
+        case ROUTE_API_REMINDERS: {
+            Route route = { .kind = entry->kind };
+            if (!page_query_parse(request->query, &route.page)) return route_error(400, false);
+            return route;
+        }
+        case ROUTE_NOT_MODIFIED:
+        case ROUTE_VERSION:
+        case ROUTE_NOTIF:
+        case ROUTE_API_NOTIF:
+        case ROUTE_API_STATS:
+        case ROUTE_EVENTS:
+            return (Route) { .kind = entry->kind };
+        }
+        UNREACHABLE("route_request");
+    }
+
+    const Route_Prefix *prefix = route_match_prefix(path);
+    if (prefix == NULL) return route_error(404, false);
+    path.count -= prefix->prefix_len;
+    path.data  += prefix->prefix_len;
+    switch (prefix->kind) {
+    case ROUTE_NOTIF:
+    case ROUTE_API_NOTIF: {
+        // NOTE: the path is not NULL-terminated, but the head always ends with \r\n\r\n, so strtoul() stops there at most
+        char *endptr = NULL;
+        unsigned long notif_id = strtoul(path.data, &endptr, 10);
+        size_t id_len = endptr - path.data;
+        if (id_len == 0) {
+            // id was not provided
+            return route_error(404, false);
+        }
+        path.count -= id_len;
+        path.data  += id_len;
+        if (path.count > 0) {
+            // garbage after id
+            return route_error(404, false);
+        }
+        return (Route) { .kind = prefix->kind, .notif_id = notif_id };
+    }
+    case ROUTE_ERROR:
+    case ROUTE_NOT_MODIFIED:
+    case ROUTE_INDEX:
+    case ROUTE_VERSION:
+    case ROUTE_RESOURCE:
+    case ROUTE_API_NOTIFICATIONS:
+    case ROUTE_API_REMINDERS:
+    case ROUTE_API_STATS:
+    case ROUTE_EVENTS:
+        return route_error(404, false);
+    }
+    UNREACHABLE("route_request");
+}
+
+// The routes that query the database are served by the worker threads. Everything else is cheap
+// enough to be served right in the event loop.
+bool route_needs_db(Route_Kind kind)
+{
+    switch (kind) {
+    case ROUTE_INDEX:
+    case ROUTE_NOTIF:
+    case ROUTE_API_NOTIFICATIONS:
+    case ROUTE_API_NOTIF:
+    case ROUTE_API_REMINDERS:
+    case ROUTE_API_STATS:
+        return true;
+    case ROUTE_ERROR:
+    case ROUTE_NOT_MODIFIED:
+    case ROUTE_VERSION:
+    case ROUTE_RESOURCE:
+    case ROUTE_EVENTS:
+        return false;
+    }
+    UNREACHABLE("route_needs_db");
+}
+
+// Renders the response of the route into sc->response
+void serve_route(Serve_Context *sc, Route route)
+{
+    switch (route.kind) {
+    case ROUTE_ERROR:
+        if (route.close) sc->keep_alive = false;
+        serve_error(sc, route.status_code);
+        break;
+    case ROUTE_NOT_MODIFIED:
+        http_render_not_modified(sc->out, sc->etag, "no-cache", false, serve_connection_header(sc));
+        break;
+    case ROUTE_INDEX:
+        if (!sc->db) {
+            serve_error(sc, 500);
+            break;
+        }
+        if (sc->stream) {
+            serve_index_streamed(sc, route.page);
+        } else {
+            serve_index(sc, route.page);
+        }
+        break;
+    case ROUTE_VERSION:
+        serve_version(sc);
+        break;
+    case ROUTE_RESOURCE:
+        serve_resource(sc, route.resource);
+        break;
+    case ROUTE_NOTIF:
+        if (!sc->db) {
+            serve_error(sc, 500);
+            break;
+        }
+        UNUSED(serve_notif(sc, route.notif_id));
+        break;
+    case ROUTE_API_NOTIFICATIONS:
+        if (!sc->db) {
+            serve_error(sc, 500);
+            break;
+        }
+        serve_api_notifications(sc, route.page);
+        break;
+    case ROUTE_API_REMINDERS:
+        if (!sc->db) {
+            serve_error(sc, 500);
+            break;
+        }
+        serve_api_reminders(sc, route.page);
+        break;
+    case ROUTE_API_NOTIF:
+        if (!sc->db) {
+            serve_error(sc, 500);
+            break;
+        }
+        serve_api_notif(sc, route.notif_id);
+        break;
+    case ROUTE_API_STATS:
+        if (!sc->db) {
+            serve_error(sc, 500);
+            break;
+        }
+        serve_api_stats(sc);
+        break;
+    case ROUTE_EVENTS:
+        UNREACHABLE("ROUTE_EVENTS is served by serve_connection_process()");
+    }
+}
+
+typedef struct Serve_Connection Serve_Connection;
+
+// State of a single client connection in the serve_run() event loop
+struct Serve_Connection {
+    int fd;
+    String_Builder request;     // Received bytes that are not processed yet. May contain several pipelined requests.
+    size_t scanned;             // How many bytes of the request were already scanned for the end of the head
+    size_t head_size;           // Size of the head of the current request at the beginning of the request buffer
+    Http_Request current;       // The request that is being served right now
+    Route route;                // Where the current request is routed to
+    char etag[48];              // ETag of the current request if it's a dynamic page, empty otherwise
+    uint64_t generation;        // Serve_Pages.generation the current dynamic page is rendered for
+    size_t response_start;      // Where the response of the worker starts in out.owned
+    Serve_Output out;           // Responses that are not fully sent yet
+    bool eof;                   // The client is not going to send anything anymore
+    bool closing;               // Close the connection as soon as the response is sent
+    bool busy;                  // Handed over to a worker. The event loop must not touch it until the worker gives it back.
+    bool subscribed;            // Receives the Server-Sent Events of /events until the client hangs up
+    bool streamed;              // The worker streamed the current response, so `out` has at most the spilled tail of it
+    bool registered;            // Whether the fd is in the epoll set
+    bool closed;                // Waiting in Serve_Loop.closed to be freed. The event loop must skip it.
+    Serve_Connection *next;     // Next connection in a Serve_Queue
+};
+
+typedef struct {
+    Serve_Connection *head;
+    Serve_Connection *tail;
+} Serve_Queue;
+
+typedef struct {
+    Serve_Connection **items;
+    size_t count;
+    size_t capacity;
+} Serve_Connections;
+
+void serve_queue_push(Serve_Queue *queue, Serve_Connection *conn)
+{
+    conn->next = NULL;
+    if (queue->tail) {
+        queue->tail->next = conn;
+    } else {
+        queue->head = conn;
+    }
+    queue->tail = conn;
+}
+
+Serve_Connection *serve_queue_pop(Serve_Queue *queue)
+{
+    Serve_Connection *conn = queue->head;
+    if (conn) {
+        queue->head = conn->next;
+        if (queue->head == NULL) queue->tail = NULL;
+        conn->next = NULL;
+    }
+    return conn;
+}
+
+// The event loop hands the connections with the requests that need the database over to the workers
+// through the jobs queue. The workers give them back through the done queue and wake up the event
+// loop by writing into done_fd.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t jobs_cond;   // Signaled when a job is pushed or the pool is stopping
+    Serve_Queue jobs;
+    Serve_Queue done;
+    int done_fd;                // eventfd
+    bool stopping;
+    bool stream;                // Stream the index page straight into the client sockets
+} Serve_Pool;
+
+typedef struct {
+    pthread_t thread;
+    bool started;
+    Serve_Pool *pool;
+    Serve_Context sc;
+    Serve_Stream stream;
+} Serve_Worker;
+
+void serve_connection_serve_current(Serve_Context *sc, Serve_Connection *conn)
+{
+    sc_reset(sc);
+    sc->request = &conn->current;
+    sc->out = &conn->out;
+    sc->etag = conn->etag[0] ? conn->etag : NULL;
+    sc->keep_alive = conn->current.keep_alive;
+    serve_route(sc, conn->route);
+    if (!sc->keep_alive) conn->closing = true;
+}
+
+// Removes the current request from the request buffer
+void serve_connection_consume(Serve_Connection *conn)
+{
+    memmove(conn->request.items, conn->request.items + conn->head_size, conn->request.count - conn->head_size);
+    conn->request.count -= conn->head_size;
+    conn->head_size = 0;
+    conn->scanned = 0;
+}
+
+bool serve_connection_flush(Serve_Connection *conn)
+{
+    Serve_Output *out = &conn->out;
+    output_seal(out);
+    while (out->sent_segments < out->count) {
+        struct iovec iov[64];
+        int iovcnt = 0;
+        for (size_t i = out->sent_segments; i < out->count && iovcnt < (int)ARRAY_LEN(iov); ++i) {
+            Serve_Segment *segment = &out->items[i];
+            const char *data = segment->data ? segment->data : out->owned.items + segment->offset;
+            size_t skip = i == out->sent_segments ? out->sent_bytes : 0;
+            iov[iovcnt++] = (struct iovec) {
+                .iov_base = (void*)(data + skip),
+                .iov_len = segment->size - skip,
+            };
+        }
+
+        ssize_t n = writev(conn->fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            if (errno == EINTR) continue;
+            fprintf(stderr, "ERROR: Could not write response: %s\n", strerror(errno));
+            return false;
+        }
+
+        for (size_t left = n; left > 0; ) {
+            size_t rest = out->items[out->sent_segments].size - out->sent_bytes;
+            if (left < rest) {
+                out->sent_bytes += left;
+                left = 0;
+            } else {
+                left -= rest;
+                out->sent_segments += 1;
+                out->sent_bytes = 0;
+            }
+        }
+    }
+    output_reset(out);
+    return true;
+}
+
+void *serve_worker_run(void *arg)
+{
+    Serve_Worker *worker = arg;
+    Serve_Pool *pool = worker->pool;
+    scratch_arena = &worker->sc.arena;
+
+    // Every worker has its own connection, so they don't serialize on each other. If it fails to open,
+    // the reason is logged and the worker answers the requests with 500.
+    worker->sc.db = open_tore_db();
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        Serve_Connection *conn = NULL;
+        while (!pool->stopping && (conn = serve_queue_pop(&pool->jobs)) == NULL) {
+            pthread_cond_wait(&pool->jobs_cond, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        if (conn == NULL) break;
+
+        worker->sc.stream = NULL;
+        conn->streamed = false;
+        // HTTP/1.0 clients don't know about the chunked encoding, so they get the page as a whole
+        if (pool->stream && conn->route.kind == ROUTE_INDEX && sv_eq(conn->current.version, sv_from_cstr("HTTP/1.1"))) {
+            // The responses to the pipelined requests before this one must reach the client first. If the
+            // client is not reading them, there's no point in streaming and the page is rendered as usual.
+            if (!serve_connection_flush(conn)) {
+                conn->closing = true;
+            } else if (!output_pending(&conn->out)) {
+                serve_stream_reset(&worker->stream, conn->fd, &conn->out);
+                worker->sc.stream = &worker->stream;
+                conn->streamed = true;
+            }
+        }
+        if (!conn->closing) serve_connection_serve_current(&worker->sc, conn);
+
+        pthread_mutex_lock(&pool->lock);
+        serve_queue_push(&pool->done, conn);
+        pthread_mutex_unlock(&pool->lock);
+        uint64_t one = 1;
+        if (write(pool->done_fd, &one, sizeof(one)) < 0) {
+            fprintf(stderr, "ERROR: Could not wake up the event loop: %s\n", strerror(errno));
+        }
+    }
+
+    sc_free(&worker->sc);
+    free(worker->stream.chunk.items);
+    return NULL;
+}
+
+// The event loop watches the database for the commits of the other processes, so it knows whether the
+// dynamic pages the clients have cached are still up to date without bothering the workers.
+#define PAGE_CACHE_CAPACITY 64
+
+// Complete response of a dynamic page rendered by a worker. It is valid while the database does not
+// change and until the end of the day, since the day rollover changes what `checkout` fires off.
+typedef struct {
+    char *target;               // The request target it was rendered for. NULL means the slot is free.
+    uint64_t generation;
+    time_t expires_at;
+    String_Builder response;    // Rendered for a keep-alive connection, so it has no Connection header
+    size_t head_size;           // Size of the head without the final \r\n
+} Page_Cache_Entry;
+
+typedef struct {
+    sqlite3 *db;
+    int data_version;
+    uint64_t generation;    // Bumped every time the database changes
+    uint32_t boot_nonce;    // The generations of different runs of `serve` must not be confused
+    Page_Cache_Entry cache[PAGE_CACHE_CAPACITY];
+    size_t cache_next;      // Which slot is evicted next when there are no free ones
+} Serve_Pages;
+
+Page_Cache_Entry *page_cache_find(Serve_Pages *pages, String_View target)
+{
+    for (size_t i = 0; i < PAGE_CACHE_CAPACITY; ++i) {
+        Page_Cache_Entry *entry = &pages->cache[i];
+        if (entry->target && strlen(entry->target) == target.count && memcmp(entry->target, target.data, target.count) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Returns the cached response of the target if it's still valid
+Page_Cache_Entry *page_cache_lookup(Serve_Pages *pages, String_View target, uint64_t generation)
+{
+    Page_Cache_Entry *entry = page_cache_find(pages, target);
+    if (entry == NULL) return NULL;
+    if (entry->generation != generation || time(NULL) >= entry->expires_at) return NULL;
+    return entry;
+}
+
+void page_cache_store(Serve_Pages *pages, String_View target, uint64_t generation, String_View response)
+{
+    // Only the successfully rendered keep-alive responses are cacheable
+    if (!sv_starts_with(response, sv_from_cstr("HTTP/1.1 200 "))) return;
+    size_t scanned = 0;
+    size_t head_size = http_scan_head(response.data, response.count, &scanned);
+    if (head_size == 0) return;
+
+    Page_Cache_Entry *entry = page_cache_find(pages, target);
+    if (entry == NULL) {
+        for (size_t i = 0; i < PAGE_CACHE_CAPACITY && entry == NULL; ++i) {
+            if (pages->cache[i].target == NULL || pages->cache[i].generation != generation) entry = &pages->cache[i];
+        }
+        if (entry == NULL) {
+            entry = &pages->cache[pages->cache_next];
+            pages->cache_next = (pages->cache_next + 1)%PAGE_CACHE_CAPACITY;
+        }
+        free(entry->target);
+        entry->target = malloc(target.count + 1);
+        assert(entry->target != NULL && "Buy more RAM lol");
+        memcpy(entry->target, target.data, target.count);
+        entry->target[target.count] = '\0';
+    }
+
+    entry->generation = generation;
+    entry->expires_at = next_local_midnight();
+    entry->response.count = 0;
+    sb_append_buf(&entry->response, response.data, response.count);
+    entry->head_size = head_size - 2;
+}
+
+void page_cache_free(Serve_Pages *pages)
+{
+    for (size_t i = 0; i < PAGE_CACHE_CAPACITY; ++i) {
+        free(pages->cache[i].target);
+        free(pages->cache[i].response.items);
+    }
+}
+
+uint64_t serve_pages_generation(Serve_Pages *pages)
+{
+    int data_version = 0;
+    if (!query_int(pages->db, "PRAGMA data_version;", &data_version)) {
+        // Can't tell whether anything changed, so let's assume it did
+        pages->generation += 1;
+    } else if (data_version != pages->data_version) {
+        pages->data_version = data_version;
+        pages->generation += 1;
+    }
+    return pages->generation;
+}
+
+// The /events clients are told about the changes of the active Notifications. The writers are the other
+// processes, so sqlite3_update_hook() would never see them. Instead inotify tells when any file in
+// ~/.tore changes, PRAGMA data_version tells whether that was a commit and the snapshots of the active
+// Notifications before and after it are diffed. Without subscribers nothing is queried at all.
+// How much a subscriber that does not read the events may fall behind before it's dropped
+#define SERVE_EVENTS_MAX_BACKLOG (1024*1024)
+
+typedef struct {
+    int id;
+    char *title;
+} Events_Notification;
+
+typedef struct {
+    Events_Notification *items;     // Sorted by id
+    size_t count;
+    size_t capacity;
+} Events_Snapshot;
+
+typedef struct {
+    int inotify_fd;
+    bool ready;                 // Whether the snapshot is taken
+    uint64_t generation;        // Serve_Pages.generation the snapshot was taken at
+    Events_Snapshot snapshot;
+    Serve_Connections subscribers;
+    String_Builder message;
+} Serve_Events;
+
+void events_snapshot_free(Events_Snapshot *snapshot)
+{
+    for (size_t i = 0; i < snapshot->count; ++i) free(snapshot->items[i].title);
+    snapshot->count = 0;
+}
+
+bool events_snapshot_load(sqlite3 *db, Events_Snapshot *snapshot)
+{
+    bool result = true;
+    sqlite3_stmt *stmt = NULL;
+
+    int ret = stmt_prepare(db, "SELECT id, title FROM Notifications WHERE dismissed_at IS NULL ORDER BY id;", &stmt);
+    if (ret != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+
+    for (ret = sqlite3_step(stmt); ret == SQLITE_ROW; ret = sqlite3_step(stmt)) {
+        char *title = strdup((const char *)sqlite3_column_text(stmt, 1));
+        assert(title != NULL && "Buy more RAM lol");
+        da_append(snapshot, ((Events_Notification) {
+            .id = sqlite3_column_int(stmt, 0),
+            .title = title,
+        }));
+    }
+
+    if (ret != SQLITE_DONE) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+
+defer:
+    if (stmt) stmt_release(stmt);
+    if (!result) events_snapshot_free(snapshot);
+    return result;
+}
+
+void events_append(String_Builder *message, const char *event, const Events_Notification *notif, bool with_title)
+{
+    sb_append_cstr(message, "event: ");
+    sb_append_cstr(message, event);
+    sb_append_cstr(message, "\ndata: {\"id\":");
+    sb_append_int(message, notif->id);
+    if (with_title) {
+        sb_append_cstr(message, ",\"title\":");
+        sb_append_json_buf(message, notif->title, strlen(notif->title));
+    }
+    sb_append_cstr(message, "}\n\n");
+}
+
+// Both snapshots are sorted by id, so they are diffed in a single merge pass
+void events_diff(String_Builder *message, const Events_Snapshot *old, const Events_Snapshot *new)
+{
+    size_t i = 0, j = 0;
+    while (i < old->count || j < new->count) {
+        if (j >= new->count || (i < old->count && old->items[i].id < new->items[j].id)) {
+            events_append(message, "dismissed", &old->items[i++], false);
+        } else if (i >= old->count || new->items[j].id < old->items[i].id) {
+            events_append(message, "added", &new->items[j++], true);
+        } else {
+            if (strcmp(old->items[i].title, new->items[j].title) != 0) {
+                events_append(message, "changed", &new->items[j], true);
+            }
+            i += 1;
+            j += 1;
+        }
+    }
+}
+
+void serve_events_unsubscribe(Serve_Events *events, Serve_Connection *conn)
+{
+    for (size_t i = 0; i < events->subscribers.count; ++i) {
+        if (events->subscribers.items[i] == conn) {
+            events->subscribers.items[i] = events->subscribers.items[--events->subscribers.count];
+            break;
+        }
+    }
+    if (events->subscribers.count == 0) {
+        // Nobody to diff for, so the snapshot would only go stale
+        events_snapshot_free(&events->snapshot);
+        events->ready = false;
+    }
+}
+
+void serve_events_free(Serve_Events *events)
+{
+    if (events->inotify_fd >= 0) close(events->inotify_fd);
+    events_snapshot_free(&events->snapshot);
+    free(events->snapshot.items);
+    free(events->subscribers.items);
+    free(events->message.items);
+}
+
+typedef struct {
+    int epoll_fd;
+    Serve_Context sc;   // For the requests that are served right in the event loop
+    Serve_Pool pool;
+    Serve_Pages pages;
+    Serve_Events events;
+    // The connections closed while handling the current batch of epoll events. The rest of the batch may
+    // still have events of them, so they are only freed after it.
+    Serve_Connections closed;
+} Serve_Loop;
+
+// Turns the connection into a subscriber of /events. The response has neither Content-Length nor chunked
+// encoding, so it lasts until the connection is closed and nothing can be pipelined after it.
+void serve_events_subscribe(Serve_Loop *loop, Serve_Connection *conn)
+{
+    Serve_Events *events = &loop->events;
+    if (!events->ready) {
+        events->generation = serve_pages_generation(&loop->pages);
+        events->ready = events_snapshot_load(loop->pages.db, &events->snapshot);
+    }
+    if (!events->ready) {
+        loop->sc.out = &conn->out;
+        loop->sc.keep_alive = false;
+        serve_error(&loop->sc, 500);
+        conn->closing = true;
+        return;
+    }
+
+    sb_append_cstr(&conn->out.owned,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "retry: 3000\n\n");
+    conn->subscribed = true;
+    da_append(&events->subscribers, conn);
+}
+
+// Serves the complete requests accumulated in the connection one by one. Their responses are queued in
+// the order of the requests, which is what HTTP/1.1 pipelining expects. So it stops at the first request
+// that needs the database and hands the whole connection over to the workers until it's served.
+void serve_connection_process(Serve_Loop *loop, Serve_Connection *conn)
+{
+    if (conn->subscribed) {
+        // The subscribers have nothing more to say. Whatever they send is ignored.
+        conn->request.count = 0;
+        conn->scanned = 0;
+        return;
+    }
+    while (!conn->closing) {
+        conn->etag[0] = '\0';
+        conn->head_size = http_scan_head(conn->request.items, conn->request.count, &conn->scanned);
+        if (conn->head_size == 0) {
+            if (conn->request.count <= HTTP_MAX_HEAD_SIZE) break;
+            // Not waiting for the rest of a head that is too big anyway
+            conn->head_size = conn->request.count;
+            conn->route = route_error(431, true);
+        } else if (conn->head_size > HTTP_MAX_HEAD_SIZE) {
+            conn->route = route_error(431, true);
+        } else {
+            int status_code = http_parse_request_head(sv_from_parts(conn->request.items, conn->head_size), &conn->current);
+            conn->route = status_code == 0 ? route_request(&conn->current) : route_error(status_code, true);
+        }
+
+        if (route_needs_db(conn->route.kind)) {
+            // The worker may render the page after a newer commit than the one the ETag is computed for.
+            // That only means that the client fetches the same page once more later, never a stale one.
+            // The same goes for the page cache.
+            conn->generation = serve_pages_generation(&loop->pages);
+            snprintf(conn->etag, sizeof(conn->etag), "W/\"%08x-%llu\"",
+                     loop->pages.boot_nonce, (unsigned long long)conn->generation);
+            if (http_etag_matches(&conn->current, conn->etag)) {
+                conn->route = (Route) { .kind = ROUTE_NOT_MODIFIED };
+            }
+        }
+
+        if (route_needs_db(conn->route.kind)) {
+            Page_Cache_Entry *entry = page_cache_lookup(&loop->pages, conn->current.target, conn->generation);
+            if (entry) {
+                String_Builder *owned = &conn->out.owned;
+                sb_append_buf(owned, entry->response.items, entry->head_size);
+                sb_append_cstr(owned, http_connection_header(&conn->current, conn->current.keep_alive));
+                sb_append_cstr(owned, "\r\n");
+                sb_append_buf(owned, entry->response.items + entry->head_size + 2, entry->response.count - entry->head_size - 2);
+                if (!conn->current.keep_alive) conn->closing = true;
+                serve_connection_consume(conn);
+                continue;
+            }
+        }
+
+        if (conn->route.kind == ROUTE_EVENTS) {
+            serve_events_subscribe(loop, conn);
+            serve_connection_consume(conn);
+            if (conn->subscribed) serve_connection_process(loop, conn);
+            return;
+        }
+
+        if (route_needs_db(conn->route.kind)) {
+            conn->response_start = conn->out.owned.count;
+            conn->busy = true;
+            pthread_mutex_lock(&loop->pool.lock);
+            serve_queue_push(&loop->pool.jobs, conn);
+            pthread_cond_signal(&loop->pool.jobs_cond);
+            pthread_mutex_unlock(&loop->pool.lock);
+            return;
+        }
+
+        serve_connection_serve_current(&loop->sc, conn);
+        temp_reset();
+        serve_connection_consume(conn);
+    }
+}
+
+void serve_connection_close(Serve_Loop *loop, Serve_Connection *conn)
+{
+    if (conn->subscribed) serve_events_unsubscribe(&loop->events, conn);
+    close(conn->fd);
+    conn->closed = true;
+    da_append(&loop->closed, conn);
+}
+
+void serve_connection_free(Serve_Connection *conn)
+{
+    free(conn->request.items);
+    free(conn->out.items);
+    free(conn->out.owned.items);
+    free(conn);
+}
+
+// Carries on with the connection in the event loop after new data has arrived or a worker gave it back
+void serve_connection_resume(Serve_Loop *loop, Serve_Connection *conn, bool alive)
+{
+    if (alive) {
+        // The requests that were sent before the end of the stream still deserve their responses
+        serve_connection_process(loop, conn);
+        if (conn->busy) {
+            // Unregistering the connection while the worker owns it, so its level-triggered events
+            // (like the client hanging up) do not spin the event loop in the meantime.
+            if (conn->registered && epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL) < 0) {
+                fprintf(stderr, "ERROR: Could not unregister the client socket from epoll: %s\n", strerror(errno));
+            }
+            conn->registered = false;
+            return;
+        }
+        if (conn->eof) conn->closing = true;
+        alive = serve_connection_flush(conn);
+    }
+
+    bool pending = output_pending(&conn->out);
+    if (!alive || (conn->closing && !pending)) {
+        // epoll forgets about the file descriptor automatically when it's closed
+        serve_connection_close(loop, conn);
+        return;
+    }
+
+    // While the response is stuck in the socket we stop reading new requests, so a client that
+    // pipelines requests but never reads the responses cannot make us buffer them indefinitely.
+    struct epoll_event client_event = { .events = pending ? EPOLLOUT : EPOLLIN, .data.ptr = conn };
+    if (epoll_ctl(loop->epoll_fd, conn->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, conn->fd, &client_event) < 0) {
+        fprintf(stderr, "ERROR: Could not register the client socket in epoll: %s\n", strerror(errno));
+        serve_connection_close(loop, conn);
+        return;
+    }
+    conn->registered = true;
+}
+
+// Called when something in ~/.tore has changed
+void serve_events_notify(Serve_Loop *loop)
+{
+    Serve_Events *events = &loop->events;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (read(events->inotify_fd, buffer, sizeof(buffer)) > 0) {
+        // Draining the queue. It's not important what exactly has changed, the whole batch is handled at once.
+    }
+    if (!events->ready) return;
+
+    uint64_t generation = serve_pages_generation(&loop->pages);
+    if (generation == events->generation) return;
+
+    Events_Snapshot snapshot = {0};
+    if (!events_snapshot_load(loop->pages.db, &snapshot)) {
+        free(snapshot.items);
+        return;
+    }
+    events->message.count = 0;
+    events_diff(&events->message, &events->snapshot, &snapshot);
+    events_snapshot_free(&events->snapshot);
+    free(events->snapshot.items);
+    events->snapshot = snapshot;
+    events->generation = generation;
+    if (events->message.count == 0) return;
+
+    // Iterating backwards, because the dropped subscribers are swapped with the last ones
+    for (size_t i = events->subscribers.count; i > 0; --i) {
+        Serve_Connection *conn = events->subscribers.items[i - 1];
+        bool alive = conn->out.owned.count < SERVE_EVENTS_MAX_BACKLOG;
+        if (alive) sb_append_buf(&conn->out.owned, events->message.items, events->message.count);
+        serve_connection_resume(loop, conn, alive);
+    }
+}
+
+bool serve_run(Command *self, const char *program_name, int argc, char **argv)
+{
+    UNUSED(self);
+    bool result = true;
+    Serve_Loop loop = {
+        .epoll_fd = -1,
+        .pool = {
+            .lock = PTHREAD_MUTEX_INITIALIZER,
+            .jobs_cond = PTHREAD_COND_INITIALIZER,
+            .done_fd = -1,
+        },
+        .pages = {
+            .boot_nonce = (uint32_t)time(NULL)^((uint32_t)getpid() << 16),
+        },
+        .events = {
+            .inotify_fd = -1,
+        },
+    };
+    Serve_Worker *workers = NULL;
+    size_t workers_count = nprocs();
+    int server_fd = -1;
+    // NOTE: We are intentionally not listening to the external addresses, because we are using a
+    // custom scuffed implementation of HTTP protocol, which is incomplete and possibly insecure.
+    // The `serve` command is meant to be used only locally by a single person. At least for now.
+    // We are doing it for the sake of simplicity, 'cause we don't have to ship an entire proper
+    // HTTP server. Though, if you really want to, you can always slap some reverse proxy like nginx
+    // on top of the `serve`.
+    const char *addr = "127.0.0.1";
+    uint16_t port = DEFAULT_SERVE_PORT;
+    for (size_t positional = 0; argc > 0; ) {
+        const char *arg = shift(argv, argc);
+        if (strcmp(arg, "-stream") == 0) {
+            loop.pool.stream = true;
+            continue;
+        }
+        if (positional == 0) {
+            port = atoi(arg);
+        } else if (positional == 1) {
+            int n = atoi(arg);
+            if (n <= 0) {
+                fprintf(stderr, "ERROR: %s is not a valid amount of workers\n", arg);
+                fprintf(stderr, "Usage: %s %s\n", program_name, self->signature);
+                return_defer(false);
+            }
+            workers_count = n;
+        } else {
+            fprintf(stderr, "ERROR: Unexpected argument %s\n", arg);
+            fprintf(stderr, "Usage: %s %s\n", program_name, self->signature);
+            return_defer(false);
+        }
+        positional += 1;
+    }
+    if (workers_count == 0) workers_count = 1;
+
+    // Writing into a connection that was closed by the client must not kill the whole server
+    signal(SIGPIPE, SIG_IGN);
+
+    server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (server_fd < 0) {
+        fprintf(stderr, "ERROR: Could not create socket epicly: %s\n", strerror(errno));
+        return_defer(false);
+    }
+
+    int option = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    server_addr.sin_addr.s_addr = inet_addr(addr);
+
+    ssize_t err = bind(server_fd, (struct sockaddr*) &server_addr, sizeof(server_addr));
+    if (err != 0) {
+        fprintf(stderr, "ERROR: Could not bind socket epicly: %s\n", strerror(errno));
+        return_defer(false);
+    }
+
+    err = listen(server_fd, 69);
+    if (err != 0) {
+        fprintf(stderr, "ERROR: Could not listen to socket, it's too quiet: %s\n", strerror(errno));
+        return_defer(false);
+    }
+
+    // Applying the migrations once before the workers race each other to do that. The database is in
+    // WAL mode, so the workers can serve the pages concurrently with each other and with the writers.
+    // This connection stays in the event loop to watch PRAGMA data_version.
+    loop.pages.db = open_tore_db();
+    if (!loop.pages.db) return_defer(false);
+
+    loop.pool.done_fd = eventfd(0, EFD_NONBLOCK);
+    if (loop.pool.done_fd < 0) {
+        fprintf(stderr, "ERROR: Could not create eventfd: %s\n", strerror(errno));
+        return_defer(false);
+    }
+
+    workers = calloc(workers_count, sizeof(*workers));
+    assert(workers != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < workers_count; ++i) {
+        workers[i].pool = &loop.pool;
+        int ret = pthread_create(&workers[i].thread, NULL, serve_worker_run, &workers[i]);
+        if (ret != 0) {
+            fprintf(stderr, "ERROR: Could not start a worker thread: %s\n", strerror(ret));
+            return_defer(false);
+        }
+        workers[i].started = true;
+    }
+
+    loop.epoll_fd = epoll_create1(0);
+    if (loop.epoll_fd < 0) {
+        fprintf(stderr, "ERROR: Could not create epoll instance: %s\n", strerror(errno));
+        return_defer(false);
+    }
+
+    // The listening socket is registered with .data.ptr == NULL, the eventfd of the pool with
+    // .data.ptr == &loop.pool and inotify with .data.ptr == &loop.events. All the others point at
+    // their Serve_Connection.
+    struct epoll_event server_event = { .events = EPOLLIN, .data.ptr = NULL };
+    if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, server_fd, &server_event) < 0) {
+        fprintf(stderr, "ERROR: Could not register the server socket in epoll: %s\n", strerror(errno));
+        return_defer(false);
+    }
+    struct epoll_event pool_event = { .events = EPOLLIN, .data.ptr = &loop.pool };
+    if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.pool.done_fd, &pool_event) < 0) {
+        fprintf(stderr, "ERROR: Could not register the eventfd in epoll: %s\n", strerror(errno));
+        return_defer(false);
+    }
+
+    // Not fatal. The /events clients just never hear about any changes.
+    loop.events.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (loop.events.inotify_fd < 0) {
+        fprintf(stderr, "WARNING: Could not initialize inotify: %s\n", strerror(errno));
+    } else if (inotify_add_watch(loop.events.inotify_fd, TORE_DIR_PATH, IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+        fprintf(stderr, "WARNING: Could not watch %s: %s\n", TORE_DIR_PATH, strerror(errno));
+    } else {
+        struct epoll_event inotify_event = { .events = EPOLLIN, .data.ptr = &loop.events };
+        if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.events.inotify_fd, &inotify_event) < 0) {
+            fprintf(stderr, "WARNING: Could not register inotify in epoll: %s\n", strerror(errno));
+        }
+    }
+
+    printf("Listening to http://%s:%d/ with %zu workers%s\n", addr, port, workers_count, loop.pool.stream ? ", streaming the index page" : "");
+
+    struct epoll_event events[64];
+    for (;;) {
+        int events_count = epoll_wait(loop.epoll_fd, events, ARRAY_LEN(events), -1);
+        if (events_count < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "ERROR: Could not wait for events: %s\n", strerror(errno));
+            return_defer(false);
+        }
+
+        for (int i = 0; i < events_count; ++i) {
+            if (events[i].data.ptr == &loop.events) {
+                serve_events_notify(&loop);
+                continue;
+            }
+
+            if (events[i].data.ptr == &loop.pool) {
+                uint64_t counter;
+                if (read(loop.pool.done_fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN) {
+                    fprintf(stderr, "ERROR: Could not read eventfd: %s\n", strerror(errno));
+                }
+                pthread_mutex_lock(&loop.pool.lock);
+                Serve_Queue done = loop.pool.done;
+                loop.pool.done = (Serve_Queue) {0};
+                pthread_mutex_unlock(&loop.pool.lock);
+
+                for (Serve_Connection *conn = serve_queue_pop(&done); conn != NULL; conn = serve_queue_pop(&done)) {
+                    conn->busy = false;
+                    // The cached responses get their Connection header when they are replayed, so they must not have one
+                    if (*http_connection_header(&conn->current, conn->current.keep_alive) == '\0' && !conn->streamed) {
+                        String_Builder *owned = &conn->out.owned;
+                        String_View response = sv_from_parts(owned->items + conn->response_start, owned->count - conn->response_start);
+                        page_cache_store(&loop.pages, conn->current.target, conn->generation, response);
+                    }
+                    serve_connection_consume(conn);
+                    serve_connection_resume(&loop, conn, true);
+                }
+                continue;
+            }
+
+            Serve_Connection *conn = events[i].data.ptr;
+            if (conn != NULL && conn->closed) continue;
 
-void serve_request(Serve_Context *sc)
-{
-    // TODO: should `serve` fire off reminders?
-    // TODO: log HTTP queries
+            if (conn == NULL) {
+                for (;;) {
+                    int client_fd = accept(server_fd, NULL, NULL);
+                    if (client_fd < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                            fprintf(stderr, "ERROR: Could not accept connection. This is unacceptable! %s\n", strerror(errno));
+                        }
+                        break;
+                    }
+                    fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL, 0) | O_NONBLOCK);
+                    conn = calloc(1, sizeof(*conn));
+                    assert(conn != NULL && "Buy more RAM lol");
+                    conn->fd = client_fd;
+                    serve_connection_resume(&loop, conn, true);
+                }
+                continue;
+            }
 
-    // <Status-Line>\r\n<Header>\r\n<Header>\r\n<Header>\r\n<Header>\r\n<Header>\r\n\r\n
-    char buffer[1024];
-    size_t cur = 0;
-    String_View suffix = sv_from_parts("\r\n\r\n", 4);
-    bool finish = false;
-    ssize_t n = 0;
-    do {
-        n = read(sc->client_fd, buffer, sizeof(buffer));
-        if (n <= 0) break;
-        sb_append_buf(&sc->request, buffer, n);
-        for (; cur < sc->request.count && !finish; cur += 1) {
-            finish = nob_sv_starts_with(sv_from_parts(sc->request.items + cur, sc->request.count - cur), suffix);
+            bool alive = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                char buffer[4096];
+                // Whatever is left unread is picked up on the next iteration of the event loop after the
+                // buffered requests are served, so a client can't make the request buffer grow indefinitely.
+                while (conn->request.count <= HTTP_MAX_HEAD_SIZE) {
+                    ssize_t n = read(conn->fd, buffer, sizeof(buffer));
+                    if (n > 0) {
+                        sb_append_buf(&conn->request, buffer, n);
+                        continue;
+                    }
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                    if (n < 0 && errno == EINTR) continue;
+                    // The client is gone or does not want to send anything anymore
+                    if (n < 0) alive = false;
+                    conn->eof = true;
+                    break;
+                }
+            }
+
+            serve_connection_resume(&loop, conn, alive);
         }
-    } while (!finish);
 
-    if (n < 0) {
-        fprintf(stderr, "ERROR: could not read request: %s", strerror(errno));
-        return;
+        for (size_t i = 0; i < loop.closed.count; ++i) serve_connection_free(loop.closed.items[i]);
+        loop.closed.count = 0;
     }
 
-    // NULL terminating the request buffer, just in case we need to use some stupid libc functions
-    // that only work with NULL-terminated strings.
-    sb_append_null(&sc->request);
+    // TODO: The only way to stop the server is by SIGINT, but that probably doesn't close the db correctly.
+    // So we probably should add a SIGINT handler specifically for this.
 
-    String_View request = sb_to_sv(sc->request);
-    String_View status_line = sv_trim(sv_chop_by_delim(&request, '\n'));
-    String_View method = sv_trim(sv_chop_by_delim(&status_line, ' '));
-    UNUSED(method);
-    String_View uri =  sv_trim(sv_chop_by_delim(&status_line, ' '));
+    UNREACHABLE("serve");
 
-    if (sv_eq(uri, sv_from_cstr("/"))) {
-        serve_index(sc);
-        return;
-    }
-    if (sv_eq(uri, sv_from_cstr("/version"))) {
-        serve_version(sc);
-        return;
-    }
-    if (sv_eq(uri, sv_from_cstr("/favicon.ico"))) {
-        serve_resource(sc, "./resources/images/tore.png", "image/png");
-        return;
-    }
-    if (sv_eq(uri, sv_from_cstr("/css/reset.css"))) {
-        serve_resource(sc, "./resources/css/reset.css", "text/css");
-        return;
-    }
-    if (sv_eq(uri, sv_from_cstr("/css/main.css"))) {
-        serve_resource(sc, "./resources/css/main.css", "text/css");
-        return;
-    }
-    if (sv_eq(uri, sv_from_cstr("/urmom"))) {
-        serve_error(sc, 413);
-        return;
-    }
-    if (sv_starts_with(uri, sv_from_cstr("/notif/"))) {
-        String_View notif_uri_prefix = sv_from_cstr("/notif/");
-        uri.count -= notif_uri_prefix.count;
-        uri.data += notif_uri_prefix.count;
-        char *endptr = NULL;
-        unsigned long notif_id = strtoul(uri.data, &endptr, 10);
-        size_t id_len = endptr - uri.data;
-        if (id_len == 0) {
-            // id was not provided
-            serve_error(sc, 404);
-            return;
-        }
-        uri.count -= id_len;
-        uri.data  += id_len;
-        if (uri.count > 0) {
-            // garbage after id
-            serve_error(sc, 404);
-            return;
+defer:
+    // TODO: properly close the client sockets on defer
+    if (workers) {
+        pthread_mutex_lock(&loop.pool.lock);
+        loop.pool.stopping = true;
+        pthread_cond_broadcast(&loop.pool.jobs_cond);
+        pthread_mutex_unlock(&loop.pool.lock);
+        for (size_t i = 0; i < workers_count; ++i) {
+            if (workers[i].started) pthread_join(workers[i].thread, NULL);
         }
-        UNUSED(serve_notif(sc, notif_id));
-        return;
+        free(workers);
     }
+    if (loop.pool.done_fd >= 0) close(loop.pool.done_fd);
+    if (loop.epoll_fd >= 0) close(loop.epoll_fd);
+    if (server_fd >= 0) close(server_fd);
+    sc_free(&loop.sc);
+    serve_events_free(&loop.events);
+    for (size_t i = 0; i < loop.closed.count; ++i) serve_connection_free(loop.closed.items[i]);
+    free(loop.closed.items);
+    if (loop.pages.db) close_tore_db(loop.pages.db);
+    page_cache_free(&loop.pages);
+    return result;
+}
+
+// Does the same thing `checkout` does, but keeps the rendered Mailbox in memory
+bool daemon_refresh(sqlite3 *db, Checkout_Cache *cc, char fired_at[DATE_BUFFER_SIZE])
+{
+    bool result = true;
+    bool txn_started = false;
+
+    if (!txn_begin_write(db)) return_defer(false);
+    txn_started = true;
+    if (!fire_off_reminders(db)) return_defer(false);
+    if (!checkout_cache_prepare(db, cc)) return_defer(false);
+    if (!txn_commit(db)) return_defer(false);
+    txn_started = false;
+
+    UNUSED(checkout_cache_save(db, cc));
+    strcpy(fired_at, today_local_temp());
 
-    serve_error(sc, 404);
+defer:
+    if (txn_started) UNUSED(txn_rollback(db));
+    return result;
 }
 
-bool serve_run(Command *self, const char *program_name, int argc, char **argv)
+bool daemon_run(Command *self, const char *program_name, int argc, char **argv)
 {
     UNUSED(self);
     UNUSED(program_name);
+    UNUSED(argc);
+    UNUSED(argv);
+
     bool result = true;
-    // NOTE: We are intentionally not listening to the external addresses, because we are using a
-    // custom scuffed implementation of HTTP protocol, which is incomplete and possibly insecure.
-    // The `serve` command is meant to be used only locally by a single person. At least for now.
-    // We are doing it for the sake of simplicity, 'cause we don't have to ship an entire proper
-    // HTTP server. Though, if you really want to, you can always slap some reverse proxy like nginx
-    // on top of the `serve`.
-    const char *addr = "127.0.0.1";
-    uint16_t port = DEFAULT_SERVE_PORT;
-    if (argc > 0) port = atoi(shift(argv, argc));
+    sqlite3 *db = NULL;
+    int server_fd = -1;
+    int signal_fd = -1;
+    bool socket_bound = false;
+    Checkout_Cache cc = {0};
+    char fired_at[DATE_BUFFER_SIZE] = {0};  // The local date of the last fire_off_reminders()
+
+    signal(SIGPIPE, SIG_IGN);
+
+    // Receiving SIGINT and SIGTERM through the poll() below instead of dying on them, so the socket gets removed on exit
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    if (sigprocmask(SIG_BLOCK, &stop_signals, NULL) < 0) {
+        fprintf(stderr, "ERROR: Could not block the termination signals: %s\n", strerror(errno));
+        return_defer(false);
+    }
+    signal_fd = signalfd(-1, &stop_signals, SFD_CLOEXEC);
+    if (signal_fd < 0) {
+        fprintf(stderr, "ERROR: Could not create signalfd: %s\n", strerror(errno));
+        return_defer(false);
+    }
 
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
-        fprintf(stderr, "ERROR: Could not create socket epicly: %s\n", strerror(errno));
+    db = open_tore_db();
+    if (!db) return_defer(false);
+
+    struct sockaddr_un addr;
+    if (!daemon_socket_addr(&addr)) {
+        fprintf(stderr, "ERROR: %s is too long to be a path of a Unix socket\n", TORE_DAEMON_SOCKET_PATH);
         return_defer(false);
     }
 
-    int option = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+    server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        fprintf(stderr, "ERROR: Could not create socket: %s\n", strerror(errno));
+        return_defer(false);
+    }
 
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    server_addr.sin_addr.s_addr = inet_addr(addr);
+    if (connect(server_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+        fprintf(stderr, "ERROR: Another daemon is already listening on %s\n", TORE_DAEMON_SOCKET_PATH);
+        return_defer(false);
+    }
+    // Nobody is listening on the socket, so it is a leftover from a daemon that did not exit cleanly
+    unlink(TORE_DAEMON_SOCKET_PATH);
 
-    ssize_t err = bind(server_fd, (struct sockaddr*) &server_addr, sizeof(server_addr));
-    if (err != 0) {
-        fprintf(stderr, "ERROR: Could not bind socket epicly: %s\n", strerror(errno));
+    if (bind(server_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "ERROR: Could not bind %s: %s\n", TORE_DAEMON_SOCKET_PATH, strerror(errno));
         return_defer(false);
     }
+    socket_bound = true;
 
-    err = listen(server_fd, 69);
-    if (err != 0) {
-        fprintf(stderr, "ERROR: Could not listen to socket, it's too quiet: %s\n", strerror(errno));
+    if (listen(server_fd, 69) < 0) {
+        fprintf(stderr, "ERROR: Could not listen to %s: %s\n", TORE_DAEMON_SOCKET_PATH, strerror(errno));
         return_defer(false);
     }
 
-    printf("Listening to http://%s:%d/\n", addr, port);
+    if (!daemon_refresh(db, &cc, fired_at)) return_defer(false);
+    printf("Listening to %s\n", TORE_DAEMON_SOCKET_PATH);
+    fflush(stdout);
 
-    Serve_Context sc = {0};
+    // The iterations only rewind their own temporary allocations, whatever is set up before the loop stays valid
+    size_t mark = temp_save();
     for (;;) {
-        struct sockaddr_in client_addr;
-        socklen_t client_addrlen = 0;
-        sc.client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &client_addrlen);
-        if (sc.client_fd < 0) {
-            fprintf(stderr, "ERROR: Could not accept connection. This is unacceptable! %s\n", strerror(errno));
+        temp_rewind(mark);
+
+        time_t now = time(NULL);
+        time_t midnight = next_local_midnight();
+        int timeout_ms = midnight > now ? (int)(midnight - now)*1000 + 1000 : 1000;
+        struct pollfd pfds[] = {
+            { .fd = server_fd, .events = POLLIN },
+            { .fd = signal_fd, .events = POLLIN },
+        };
+        int ret = poll(pfds, ARRAY_LEN(pfds), timeout_ms);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "ERROR: Could not poll %s: %s\n", TORE_DAEMON_SOCKET_PATH, strerror(errno));
+            return_defer(false);
+        }
+
+        if (pfds[1].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+                printf("Received %s, exiting\n", strsignal(info.ssi_signo));
+            }
+            return_defer(true);
+        }
+
+        // It is a new day, so new Reminders might be due
+        if (strcmp(fired_at, today_local_temp()) != 0) {
+            if (!daemon_refresh(db, &cc, fired_at)) continue;
+        }
+
+        if (!(pfds[0].revents & POLLIN)) continue;
+
+        int client_fd = accept(server_fd, NULL, NULL);
+        if (client_fd < 0) {
+            fprintf(stderr, "ERROR: Could not accept connection: %s\n", strerror(errno));
             continue;
         }
 
-        UNUSED(serve_request(&sc));
+        // Somebody else (`n:new`, `tui`, the sqlite3 CLI, etc) might have modified the database since the last refresh
+        int data_version = 0;
+        if (query_int(db, "PRAGMA data_version;", &data_version) && data_version != cc.data_version) {
+            if (!daemon_refresh(db, &cc, fired_at)) {
+                // Replying nothing makes the client fall back to checking out by itself
+                close(client_fd);
+                continue;
+            }
+        }
 
-        shutdown(sc.client_fd, SHUT_WR);
-        char buffer[4096];
-        while (read(sc.client_fd, buffer, sizeof(buffer)) > 0);
-        close(sc.client_fd);
-        sc_reset(&sc);
-        temp_reset();
+        if (write_entire_sv(client_fd, sv_from_cstr(DAEMON_REPLY_MAGIC"\n"))) {
+            UNUSED(write_entire_sv(client_fd, sb_to_sv(cc.mailbox)));
+        }
+        close(client_fd);
     }
 
-    // TODO: The only way to stop the server is by SIGINT, but that probably doesn't close the db correctly.
-    // So we probably should add a SIGINT handler specifically for this.
-
-    UNREACHABLE("serve");
+    UNREACHABLE("daemon");
 
 defer:
-    // TODO: properly close the sockets on defer
+    if (server_fd >= 0) close(server_fd);
+    if (socket_bound) unlink(TORE_DAEMON_SOCKET_PATH);
+    if (signal_fd >= 0) close(signal_fd);
+    if (db) close_tore_db(db);
+    free(cc.mailbox.items);
     return result;
 }
 
@@ -1448,7 +4238,7 @@ bool noti_list_run(Command *self, const char *program_name, int argc, char **arg
 defer:
     if (db) {
         if (result) result = txn_commit(db);
-        sqlite3_close(db);
+        close_tore_db(db);
     }
     return result;
 }
@@ -1457,6 +4247,7 @@ bool noti_new_run(Command *self, const char *program_name, int argc, char **argv
 {
     bool result = true;
     sqlite3 *db = NULL;
+    Checkout_Cache cc = {0};
     String_Builder sb = {0};
 
     if (argc <= 0) {
@@ -1468,7 +4259,7 @@ bool noti_new_run(Command *self, const char *program_name, int argc, char **argv
 
     db = open_tore_db();
     if (!db) return_defer(false);
-    if (!txn_begin(db)) return_defer(false);
+    if (!txn_begin_write(db)) return_defer(false);
 
     for (bool pad = false; argc > 0; pad = true) {
         if (pad) sb_append_cstr(&sb, " ");
@@ -1478,13 +4269,16 @@ bool noti_new_run(Command *self, const char *program_name, int argc, char **argv
     const char *title = sb.items;
 
     if (!create_notification_with_title(db, title)) return_defer(false);
+    if (!checkout_cache_prepare(db, &cc)) return_defer(false);
     if (!show_active_notifications(db)) return_defer(false);
 
 defer:
     if (db) {
         if (result) result = txn_commit(db);
-        sqlite3_close(db);
+        if (result) UNUSED(checkout_cache_save(db, &cc));
+        close_tore_db(db);
     }
+    free(cc.mailbox.items);
     free(sb.items);
     return result;
 }
@@ -1493,6 +4287,7 @@ bool remi_dismiss_run(Command *self, const char *program_name, int argc, char **
 {
     bool result = true;
     sqlite3 *db = NULL;
+    Checkout_Cache cc = {0};
     if (argc <= 0) {
         fprintf(stderr, "Usage:\n");
         command_describe(*self, program_name, 2, DESCRIPTION_SHORT);
@@ -1502,14 +4297,17 @@ bool remi_dismiss_run(Command *self, const char *program_name, int argc, char **
     int number = atoi(shift(argv, argc));
     db = open_tore_db();
     if (!db) return_defer(false);
-    if (!txn_begin(db)) return_defer(false);
+    if (!txn_begin_write(db)) return_defer(false);
     if (!remove_reminder_by_number(db, number)) return_defer(false);
+    if (!checkout_cache_prepare(db, &cc)) return_defer(false);
     if (!show_active_reminders(db)) return_defer(false);
 defer:
     if (db) {
         if (result) result = txn_commit(db);
-        sqlite3_close(db);
+        if (result) UNUSED(checkout_cache_save(db, &cc));
+        close_tore_db(db);
     }
+    free(cc.mailbox.items);
     return result;
 }
 
@@ -1531,7 +4329,7 @@ bool remi_list_run(Command *self, const char *program_name, int argc, char **arg
 defer:
     if (db) {
         if (result) result = txn_commit(db);
-        sqlite3_close(db);
+        close_tore_db(db);
     }
     return result;
 }
@@ -1540,6 +4338,7 @@ bool remi_amend_run(Command *self, const char *program_name, int argc, char **ar
 {
     bool result = true;
     sqlite3 *db = NULL;
+    Checkout_Cache cc = {0};
     Reminders reminders = {0};
 
     if (argc <= 0) {
@@ -1593,7 +4392,7 @@ bool remi_amend_run(Command *self, const char *program_name, int argc, char **ar
 
     db = open_tore_db();
     if (!db) return_defer(false);
-    if (!txn_begin(db)) return_defer(false);
+    if (!txn_begin_write(db)) return_defer(false);
 
     if (title == NULL && scheduled_at == NULL && !amend_period) {
         fprintf(stderr, "Usage:\n");
@@ -1614,13 +4413,16 @@ bool remi_amend_run(Command *self, const char *program_name, int argc, char **ar
     if (scheduled_at) reminder.scheduled_at = scheduled_at;
     if (amend_period) reminder.period = render_period_as_sqlite3_datetime_modifier_temp(period);
     if (!amend_reminder(db, reminder)) return_defer(false);
+    if (!checkout_cache_prepare(db, &cc)) return_defer(false);
     if (!show_active_reminders(db)) return_defer(false);
 
 defer:
     if (db) {
         if (result) result = txn_commit(db);
-        sqlite3_close(db);
+        if (result) UNUSED(checkout_cache_save(db, &cc));
+        close_tore_db(db);
     }
+    free(cc.mailbox.items);
     free(reminders.items);
     return result;
 }
@@ -1629,6 +4431,7 @@ bool remi_new_run(Command *self, const char *program_name, int argc, char **argv
 {
     bool result = true;
     sqlite3 *db = NULL;
+    Checkout_Cache cc = {0};
 
     if (argc <= 0) {
         fprintf(stderr, "Usage:\n");
@@ -1657,15 +4460,18 @@ bool remi_new_run(Command *self, const char *program_name, int argc, char **argv
 
     db = open_tore_db();
     if (!db) return_defer(false);
-    if (!txn_begin(db)) return_defer(false);
+    if (!txn_begin_write(db)) return_defer(false);
     if (!create_new_reminder(db, title, scheduled_at, period)) return_defer(false);
+    if (!checkout_cache_prepare(db, &cc)) return_defer(false);
     if (!show_active_reminders(db)) return_defer(false);
 
 defer:
     if (db) {
         if (result) result = txn_commit(db);
-        sqlite3_close(db);
+        if (result) UNUSED(checkout_cache_save(db, &cc));
+        close_tore_db(db);
     }
+    free(cc.mailbox.items);
     return result;
 }
 
@@ -1686,7 +4492,7 @@ bool noti_expand_run(Command *self, const char *program_name, int argc, char **a
 defer:
     if (db) {
         if (result) result = txn_commit(db);
-        sqlite3_close(db);
+        close_tore_db(db);
     }
     return result;
 }
@@ -1713,14 +4519,161 @@ bool tui_disable_raw_terminal_mode(struct termios *saved)
     return true;
 }
 
-void tui_cursor_up(size_t lines)
+typedef struct {
+    size_t begin;
+    size_t end;
+} Tui_Line;
+
+typedef struct {
+    Tui_Line *items;
+    size_t count;
+    size_t capacity;
+} Tui_Lines;
+
+// A frame of the TUI rendered in memory. The lines are stored in the text back to back without the line breaks.
+typedef struct {
+    String_Builder text;
+    Tui_Lines lines;
+} Tui_Frame;
+
+// The frame that is on the terminal right now and the next one being rendered.
+// Between the frames the terminal cursor is parked at the beginning of the line right below the shown one.
+typedef struct {
+    Tui_Frame shown;
+    Tui_Frame next;
+    bool invalid;       // The terminal may not look like the shown frame anymore (resize, editor), so everything is repainted
+    String_Builder out;
+} Tui_Screen;
+
+// Drops the characters that do not fit into `cols` columns of the terminal, so the line never wraps and
+// takes exactly one row. The escape sequences take no space and are all kept, so the colors are still reset.
+// The widths come from the locale. Without it every byte counts as a column, which only clips more than needed.
+void tui_frame_clip_line(Tui_Frame *frame, size_t begin, size_t cols)
+{
+    String_Builder *text = &frame->text;
+    size_t width = 0;
+    bool clipped = false;
+    size_t kept = begin;
+    mbstate_t state = {0};
+    for (size_t i = begin; i < text->count; ) {
+        size_t n = 1;
+        int char_width = 0;
+        if (text->items[i] == '\x1b' && i + 1 < text->count && text->items[i + 1] == '[') {
+            // CSI sequence: parameters and intermediate bytes up to the final byte in 0x40-0x7E
+            n = 2;
+            while (i + n < text->count && !(text->items[i + n] >= 0x40 && text->items[i + n] <= 0x7E)) n += 1;
+            if (i + n < text->count) n += 1;
+        } else {
+            wchar_t wc;
+            size_t ret = mbrtowc(&wc, text->items + i, text->count - i, &state);
+            if (ret == (size_t)-1 || ret == (size_t)-2 || ret == 0) {
+                // The continuation bytes stay with their leading byte, so no character is cut in half
+                memset(&state, 0, sizeof(state));
+                while (n < 4 && i + n < text->count && ((unsigned char)text->items[i + n] & 0xC0) == 0x80) n += 1;
+                char_width = n;
+            } else {
+                n = ret;
+                if (wc == L'\t') {
+                    // The lines start at the first column, so the tab stops are counted from the beginning
+                    char_width = 8 - width%8;
+                } else {
+                    char_width = wcwidth(wc);
+                    if (char_width < 0) char_width = 1;
+                }
+            }
+            if (width + char_width > cols) clipped = true;
+            if (!clipped) width += char_width;
+        }
+        if (char_width == 0 || !clipped) {
+            memmove(text->items + kept, text->items + i, n);
+            kept += n;
+        }
+        i += n;
+    }
+    text->count = kept;
+}
+
+void tui_frame_end_line(Tui_Frame *frame, size_t cols)
+{
+    size_t begin = frame->lines.count > 0 ? frame->lines.items[frame->lines.count - 1].end : 0;
+    tui_frame_clip_line(frame, begin, cols);
+    da_append(&frame->lines, ((Tui_Line) {
+        .begin = begin,
+        .end = frame->text.count,
+    }));
+}
+
+String_View tui_frame_line(Tui_Frame *frame, size_t index)
+{
+    Tui_Line line = frame->lines.items[index];
+    return sv_from_parts(frame->text.items + line.begin, line.end - line.begin);
+}
+
+void tui_cursor_move(String_Builder *out, size_t *row, size_t target)
+{
+    if (target < *row) sb_appendf(out, "\x1b[%zuA", *row - target);
+    if (target > *row) sb_appendf(out, "\x1b[%zuB", target - *row);
+    *row = target;
+}
+
+bool tui_write_all(const char *buf, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(STDOUT_FILENO, buf, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "ERROR: could not write to the terminal: %s\n", strerror(errno));
+            return false;
+        }
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Rewrites only the lines that differ between the shown and the next frames with a single write()
+bool tui_screen_present(Tui_Screen *screen)
 {
-    printf("\x1b[%zuA", lines);
+    Tui_Frame *shown = &screen->shown;
+    Tui_Frame *next = &screen->next;
+    String_Builder *out = &screen->out;
+    out->count = 0;
+
+    size_t row = shown->lines.count;
+    for (size_t i = 0; i < next->lines.count; ++i) {
+        if (!screen->invalid && i < shown->lines.count && sv_eq(tui_frame_line(shown, i), tui_frame_line(next, i))) {
+            continue;
+        }
+        // The lines past the shown frame are always rewritten, so the cursor never needs to go down below it
+        tui_cursor_move(out, &row, i);
+        String_View line = tui_frame_line(next, i);
+        sb_append_cstr(out, "\x1b[2K");
+        sb_append_buf(out, line.data, line.count);
+        sb_append_cstr(out, "\r\n");
+        row += 1;
+    }
+    tui_cursor_move(out, &row, next->lines.count);
+    if (screen->invalid || next->lines.count < shown->lines.count) {
+        sb_append_cstr(out, "\x1b[0J");
+    }
+    screen->invalid = false;
+
+    Tui_Frame frame = *shown;
+    *shown = *next;
+    *next = frame;
+    next->text.count = 0;
+    next->lines.count = 0;
+
+    return tui_write_all(out->items, out->count);
 }
 
-void tui_erase_until_bottom(void)
+void tui_screen_free(Tui_Screen *screen)
 {
-    printf("\x1b[0J");
+    free(screen->shown.text.items);
+    free(screen->shown.lines.items);
+    free(screen->next.text.items);
+    free(screen->next.lines.items);
+    free(screen->out.items);
 }
 
 typedef enum {
@@ -1729,39 +4682,83 @@ typedef enum {
     TAS_HELP,
 } Tui_Action_Selector;
 
-// TODO: scroll view for notification selector when it does not fully fit into the screen
-size_t tui_grouped_notifications_selector(Grouped_Notifications *gns, size_t cursor, Tui_Action_Selector action_selector, const char *error_message)
+// The window of the notification list that is actually on the screen
+typedef struct {
+    size_t rows;    // The height of the terminal
+    size_t cols;    // The width of the terminal. The lines are clipped to it, so each of them takes one row.
+    size_t top;     // The index of the first visible notification
+} Tui_Viewport;
+
+static volatile sig_atomic_t tui_resized = 0;
+
+void tui_on_sigwinch(int signo)
+{
+    UNUSED(signo);
+    tui_resized = 1;
+}
+
+void tui_viewport_resize(Tui_Viewport *vp)
+{
+    struct winsize ws = {0};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) < 0 || ws.ws_row == 0 || ws.ws_col == 0) {
+        ws.ws_row = 24;
+        ws.ws_col = 80;
+    }
+    vp->rows = ws.ws_row;
+    vp->cols = ws.ws_col;
+}
+
+void tui_append_scroll_position(String_Builder *sb, Grouped_Notifications *gns, Tui_Viewport *vp, size_t visible)
+{
+    if (gns->count <= visible) return;
+    size_t end = vp->top + visible;
+    if (end > gns->count) end = gns->count;
+    sb_appendf(sb, "  (%zu-%zu of %zu)", vp->top + 1, end, gns->count);
+}
+
+// Renders only the notifications within the viewport, scrolling it to keep the cursor visible
+bool tui_grouped_notifications_selector(Tui_Screen *screen, Grouped_Notifications *gns, size_t cursor, Tui_Viewport *vp, Tui_Action_Selector action_selector, const char *error_message)
 {
-    tui_erase_until_bottom();
-    size_t lines_rendered = 0;
-    bool disable_edit = gns->count == 0;
+    Tui_Frame *frame = &screen->next;
+    bool disable_edit = gns->count == 0 || (cursor < gns->count && gns->items[cursor].group_count > 1);
     bool disable_delete = gns->count == 0;
-    for (size_t i = 0; i < gns->count; ++i) {
-        if (i == cursor && gns->items[i].group_count > 1) {
-            disable_edit = true;
-        }
+
+    // The lines below the list plus the one the terminal cursor is left on. Touching the bottom of
+    // the terminal would scroll it and tui_screen_present() would not get back to the top of the UI anymore.
+    size_t reserved = 1;
+    switch (action_selector) {
+        case TAS_NONE:           reserved += 1; break;
+        case TAS_CONFIRM_DELETE: reserved += 2; break;
+        case TAS_HELP:           reserved += 6; break;
     }
+    size_t visible = vp->rows > reserved ? vp->rows - reserved : 1;
+    if (cursor < vp->top) vp->top = cursor;
+    if (cursor >= vp->top + visible) vp->top = cursor - visible + 1;
+    // Do not leave the bottom of the screen empty when the list shrinks
+    if (vp->top + visible > gns->count) vp->top = gns->count > visible ? gns->count - visible : 0;
+
     if (gns->count > 0) {
-        for (size_t i = 0; i < gns->count; ++i) {
+        size_t end = vp->top + visible;
+        if (end > gns->count) end = gns->count;
+        for (size_t i = vp->top; i < end; ++i) {
             Grouped_Notification *it = &gns->items[i];
             assert(it->group_count > 0);
             if (i == cursor) {
-                printf("=> ");
+                sb_append_cstr(&frame->text, "=> ");
             } else {
-                printf("   ");
+                sb_append_cstr(&frame->text, "   ");
             }
             if (it->group_count == 1) {
-                printf("%s (%s)", it->title, it->created_at);
+                sb_appendf(&frame->text, "%s (%s)", it->title, it->created_at);
             } else {
-                printf("[%d] %s (%s)", it->group_count, it->title, it->created_at);
+                sb_appendf(&frame->text, "[%d] %s (%s)", it->group_count, it->title, it->created_at);
             }
             if (i == cursor) {
                 if (error_message) {
-                    printf(" \x1b[31m<- ERROR: %s\x1b[39m", error_message);
+                    sb_appendf(&frame->text, " \x1b[31m<- ERROR: %s\x1b[39m", error_message);
                 }
             }
-            printf("\r\n");
-            lines_rendered += 1;
+            tui_frame_end_line(frame, vp->cols);
             if (i == cursor) {
                 // TODO: This place must be coupled with the switch-case in tui-run which dispatches the action displayed in here.
                 // Right now to add a new action you must do 2 modifications and loosely related places. Modification in one such place
@@ -1769,52 +4766,55 @@ size_t tui_grouped_notifications_selector(Grouped_Notifications *gns, size_t cur
                 switch (action_selector) {
                     case TAS_NONE: break;
                     case TAS_CONFIRM_DELETE: {
-                        printf("      d - delete\r\n");
-                        lines_rendered += 1;
-                        printf("      Esc/Space/Enter/q - cancel\r\n");
-                        lines_rendered += 1;
+                        sb_append_cstr(&frame->text, "      d - delete");
+                        tui_frame_end_line(frame, vp->cols);
+                        sb_append_cstr(&frame->text, "      Esc/Space/Enter/q - cancel");
+                        tui_frame_end_line(frame, vp->cols);
                     } break;
                     case TAS_HELP: break;
                 }
             }
         }
     } else {
-        printf("  (no notifications)");
+        sb_append_cstr(&frame->text, "  (no notifications)");
         if (error_message) {
-            printf(" \x1b[31m<- ERROR: %s\x1b[39m", error_message);
+            sb_appendf(&frame->text, " \x1b[31m<- ERROR: %s\x1b[39m", error_message);
         }
-        printf(" \r\n");
-        lines_rendered += 1;
+        sb_append_cstr(&frame->text, " ");
+        tui_frame_end_line(frame, vp->cols);
     }
     switch (action_selector) {
         case TAS_NONE: {
-            printf("      ? - help\r\n");
-            lines_rendered += 1;
+            sb_append_cstr(&frame->text, "      ? - help");
+            tui_append_scroll_position(&frame->text, gns, vp, visible);
+            tui_frame_end_line(frame, vp->cols);
         } break;
         case TAS_HELP: {
-            printf("      w/s         - move up/down\r\n");
-            lines_rendered += 1;
-            printf("      n           - new notification\r\n");
-            lines_rendered += 1;
-            printf("      %se           - edit title\x1b[39m\r\n", disable_edit ? "\x1b[90m" : "\x1b[39m");
-            lines_rendered += 1;
-            printf("      %sEnter/Space - delete notification\x1b[39m\r\n", disable_delete ? "\x1b[90m" : "\x1b[39m");
-            lines_rendered += 1;
-            printf("      Esc/q       - quit\r\n");
-            lines_rendered += 1;
-            printf("      ? - help\r\n");
-            lines_rendered += 1;
+            sb_append_cstr(&frame->text, "      w/s         - move up/down");
+            tui_frame_end_line(frame, vp->cols);
+            sb_append_cstr(&frame->text, "      n           - new notification");
+            tui_frame_end_line(frame, vp->cols);
+            sb_appendf(&frame->text, "      %se           - edit title\x1b[39m", disable_edit ? "\x1b[90m" : "\x1b[39m");
+            tui_frame_end_line(frame, vp->cols);
+            sb_appendf(&frame->text, "      %sEnter/Space - delete notification\x1b[39m", disable_delete ? "\x1b[90m" : "\x1b[39m");
+            tui_frame_end_line(frame, vp->cols);
+            sb_append_cstr(&frame->text, "      Esc/q       - quit");
+            tui_frame_end_line(frame, vp->cols);
+            sb_append_cstr(&frame->text, "      ? - help");
+            tui_append_scroll_position(&frame->text, gns, vp, visible);
+            tui_frame_end_line(frame, vp->cols);
         } break;
         case TAS_CONFIRM_DELETE: break;
     }
-    return lines_rendered;
+    return tui_screen_present(screen);
 }
 
 int tui_read_byte(void)
 {
     char c = '\0';
     int n = read(STDIN_FILENO, &c, 1);
-    if (n < 0 && errno != EAGAIN) {
+    // EINTR is most likely SIGWINCH. Treating it as a tick without any input so the caller gets to handle it.
+    if (n < 0 && errno != EAGAIN && errno != EINTR) {
         printf("ERROR: could not read user's input: %s\n", strerror(errno));
         return -1;
     }
@@ -1848,9 +4848,17 @@ int tui_read_key(void)
     UNREACHABLE("tui_read_key");
 }
 
-bool tui_edit_title_file(const char *title_path, Cmd *cmd, String_Builder *sb, String_View *new_title)
+// The SIGWINCH handler of the TUI is installed without SA_RESTART. While the editor is running the one the TUI
+// started with is put back, otherwise resizing the terminal interrupts the waitpid() of cmd_run() and the TUI
+// exits with the editor still open.
+bool tui_edit_title_file(const char *title_path, Cmd *cmd, String_Builder *sb, String_View *new_title, const struct sigaction *saved_sigwinch)
 {
     bool result = true;
+    struct sigaction tui_sigwinch;
+    if (sigaction(SIGWINCH, saved_sigwinch, &tui_sigwinch) < 0) {
+        fprintf(stderr, "ERROR: could not restore the SIGWINCH handler: %s\n", strerror(errno));
+        return false;
+    }
     // TODO: grab the editor from $TORE_EDITOR
     cmd_append(cmd, "vi");
     cmd_append(cmd, title_path);
@@ -1860,9 +4868,124 @@ bool tui_edit_title_file(const char *title_path, Cmd *cmd, String_Builder *sb, S
     String_View sv = sb_to_sv(*sb);
     *new_title = sv_trim(sv_chop_by_delim(&sv, '\n'));
 defer:
+    if (sigaction(SIGWINCH, &tui_sigwinch, NULL) < 0) {
+        fprintf(stderr, "ERROR: could not reinstall the SIGWINCH handler: %s\n", strerror(errno));
+        result = false;
+    }
+    return result;
+}
+
+// The strings of the previously loaded Notifications are gone after this
+// `version` is the latest version of the Notifications the TUI has seen. See the migration that adds it.
+bool tui_load_notifications(sqlite3 *db, Arena *arena, Grouped_Notifications *gns, int *version)
+{
+    arena_reset(arena);
+    gns->count = 0;
+    // Taking the version before loading, so a commit sneaking in between is just patched in once more later
+    if (!query_int(db, "SELECT ifnull(max(version), 0) FROM Notifications;", version)) return false;
+    return load_active_grouped_notifications(db, gns);
+}
+
+typedef struct {
+    int *items;
+    size_t count;
+    size_t capacity;
+} Tui_Group_Ids;
+
+// Patches the loaded Notifications with the groups that changed after `*version` instead of loading and
+// grouping the whole Mailbox again. The Notifications are never deleted and never move to another group,
+// so each changed group is dropped, loaded anew if it's still active and put back where the ORDER BY ts of
+// load_active_grouped_notifications() would put it.
+bool tui_refresh_notifications(sqlite3 *db, Grouped_Notifications *gns, int *version)
+{
+    bool result = true;
+    sqlite3_stmt *stmt = NULL;
+    Tui_Group_Ids changed = {0};
+    int new_version = *version;
+
+    int ret = stmt_prepare(db, "SELECT ifnull(reminder_id, -id) as group_id, max(version) FROM Notifications WHERE version > ? GROUP BY group_id;", &stmt);
+    if (ret != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+    if (sqlite3_bind_int(stmt, 1, *version) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+    for (ret = sqlite3_step(stmt); ret == SQLITE_ROW; ret = sqlite3_step(stmt)) {
+        da_append(&changed, sqlite3_column_int(stmt, 0));
+        int changed_version = sqlite3_column_int(stmt, 1);
+        if (changed_version > new_version) new_version = changed_version;
+    }
+    if (ret != SQLITE_DONE) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(false);
+    }
+
+    for (size_t i = 0; i < changed.count; ++i) {
+        for (size_t j = 0; j < gns->count; ++j) {
+            if (gns->items[j].group_id == changed.items[i]) {
+                memmove(&gns->items[j], &gns->items[j + 1], (gns->count - j - 1)*sizeof(*gns->items));
+                gns->count -= 1;
+                break;
+            }
+        }
+
+        size_t count = gns->count;
+        if (!load_active_grouped_notification_by_group_id(db, changed.items[i], gns)) return_defer(false);
+        if (gns->count == count) continue;
+
+        // After the groups of the same second, like a freshly created Notification would be
+        Grouped_Notification it = gns->items[count];
+        size_t lo = 0, hi = count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo)/2;
+            if (strcmp(gns->items[mid].created_at, it.created_at) <= 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        memmove(&gns->items[lo + 1], &gns->items[lo], (count - lo)*sizeof(*gns->items));
+        gns->items[lo] = it;
+    }
+
+    *version = new_version;
+
+defer:
+    if (stmt) stmt_release(stmt);
+    free(changed.items);
     return result;
 }
 
+// Each action of the TUI is committed in its own short transaction, so the session does not keep the
+// database locked for `checkout`, `serve` and the others. The checkout cache is refreshed along the way.
+bool tui_commit(sqlite3 *db, Checkout_Cache *cc)
+{
+    if (!checkout_cache_prepare(db, cc)) return false;
+    if (!txn_commit(db)) return false;
+    UNUSED(checkout_cache_save(db, cc));
+    return true;
+}
+
+size_t tui_clamp_cursor(Grouped_Notifications *gns, size_t cursor)
+{
+    if (cursor < gns->count) return cursor;
+    return gns->count > 0 ? gns->count - 1 : 0;
+}
+
+// Moves the cursor to the group, if it's still there
+bool tui_find_group(Grouped_Notifications *gns, int group_id, size_t *cursor)
+{
+    for (size_t i = 0; i < gns->count; ++i) {
+        if (gns->items[i].group_id == group_id) {
+            *cursor = i;
+            return true;
+        }
+    }
+    return false;
+}
+
 bool tui_run(Command *self, const char *program_name, int argc, char **argv)
 {
     UNUSED(self);
@@ -1872,11 +4995,17 @@ bool tui_run(Command *self, const char *program_name, int argc, char **argv)
 
     bool result = true;
     sqlite3 *db = NULL;
+    Arena arena = {0};
     Grouped_Notifications gns = {0};
+    Checkout_Cache cc = {0};
     String_Builder sb = {0};
     Cmd cmd = {0};
     struct termios saved = {0};
     bool raw_terminal_enabled = false;
+    Tui_Viewport vp = {0};
+    Tui_Screen screen = {0};
+    struct sigaction saved_sigwinch = {0};
+    bool sigwinch_installed = false;
 
     if (!isatty(STDIN_FILENO)) {
         fprintf(stderr, "ERROR: Not a tty! Please run this command in a proper terminal!\n");
@@ -1886,14 +5015,37 @@ bool tui_run(Command *self, const char *program_name, int argc, char **argv)
     if (!tui_enable_raw_terminal_mode(&saved)) return_defer(false);
     raw_terminal_enabled = true;
 
+    // No SA_RESTART, so the resize interrupts the pending read() right away instead of waiting for VTIME
+    struct sigaction sa = {0};
+    sa.sa_handler = tui_on_sigwinch;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGWINCH, &sa, &saved_sigwinch) < 0) {
+        fprintf(stderr, "ERROR: could not handle the terminal resizes: %s\n", strerror(errno));
+        return_defer(false);
+    }
+    sigwinch_installed = true;
+    tui_resized = 0;
+    tui_viewport_resize(&vp);
+    // For the widths of the characters in tui_frame_clip_line()
+    setlocale(LC_CTYPE, "");
+
+    // The loaded Notifications outlive the temporary buffer which is rewound on every key. The groups replaced
+    // by tui_refresh_notifications() leave their old strings in the arena until the TUI exits, which is just a
+    // title per change.
+    scratch_arena = &arena;
+
     db = open_tore_db();
     if (!db) return_defer(false);
-    if (!txn_begin(db)) return_defer(false);
-    if (!load_active_grouped_notifications(db, &gns)) return_defer(false);
+    // PRAGMA data_version changes only when the other connections commit. Taking it before loading
+    // the Notifications, so a commit sneaking in between just causes a harmless refresh later.
+    int data_version = 0;
+    if (!query_int(db, "PRAGMA data_version;", &data_version)) return_defer(false);
+    int version = 0;
+    if (!tui_load_notifications(db, &arena, &gns, &version)) return_defer(false);
 
     size_t cursor = gns.count > 0 ? gns.count - 1 : 0;
 
-    size_t ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_NONE, NULL);
+    if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_NONE, NULL)) return_defer(false);
     enum {
         TUI_STATE_SELECT,       // Selecting notification
         TUI_STATE_ACTION,       // Picking an action on the notification
@@ -1904,24 +5056,52 @@ bool tui_run(Command *self, const char *program_name, int argc, char **argv)
         int c = tui_read_key();
 
         if (c < 0) return_defer(false);
-        if (c == 0) continue;
+        if (c == 0) {
+            // Nothing was pressed within VTIME or the terminal was resized.
+            bool redraw = false;
+            if (tui_resized) {
+                tui_resized = 0;
+                tui_viewport_resize(&vp);
+                screen.invalid = true;
+                redraw = true;
+            }
+
+            // Picking up the changes made by the other processes.
+            int new_data_version = 0;
+            if (!query_int(db, "PRAGMA data_version;", &new_data_version)) return_defer(false);
+            if (new_data_version != data_version) {
+                data_version = new_data_version;
+
+                bool had_selection = cursor < gns.count;
+                int group_id = had_selection ? gns.items[cursor].group_id : 0;
+                if (!tui_refresh_notifications(db, &gns, &version)) return_defer(false);
+                if (!had_selection || !tui_find_group(&gns, group_id, &cursor)) {
+                    cursor = tui_clamp_cursor(&gns, cursor);
+                    // The notification we were about to delete is already gone
+                    state = TUI_STATE_SELECT;
+                }
+                redraw = true;
+            }
+
+            if (redraw) {
+                if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, state == TUI_STATE_ACTION ? TAS_CONFIRM_DELETE : TAS_NONE, NULL)) return_defer(false);
+            }
+            continue;
+        }
 
         switch (state) {
         case TUI_STATE_SELECT: {
             switch (c) {
             case 'w': {
                 if (cursor > 0) cursor -= 1;
-                tui_cursor_up(ui_height);
-                ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_NONE, NULL);
+                if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_NONE, NULL)) return_defer(false);
             } break;
             case 's': {
                 if (cursor+1 < gns.count) cursor += 1;
-                tui_cursor_up(ui_height);
-                ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_NONE, NULL);
+                if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_NONE, NULL)) return_defer(false);
             } break;
             case '?': {
-                tui_cursor_up(ui_height);
-                ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_HELP, NULL);
+                if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_HELP, NULL)) return_defer(false);
             } break;
             case 'n': {
                 const char *title_path = temp_sprintf("%s/%s", TORE_DIR_PATH, TORE_TITLE_FILE_NAME);
@@ -1932,29 +5112,30 @@ bool tui_run(Command *self, const char *program_name, int argc, char **argv)
                 sb_appendf(&sb, "# Leave the first line empty to cancel.\n");
                 if (!write_entire_file(title_path, sb.items, sb.count)) return_defer(false);
                 String_View new_title = {0};
-                if (!tui_edit_title_file(title_path, &cmd, &sb, &new_title)) return_defer(false);
+                if (!tui_edit_title_file(title_path, &cmd, &sb, &new_title, &saved_sigwinch)) return_defer(false);
+                // The terminal might have been resized while the editor was open and nobody told us
+                tui_viewport_resize(&vp);
+                screen.invalid = true;
+                // Not holding any locks while the user is in the editor
                 if (new_title.count > 0) {
+                    if (!txn_begin_write(db)) return_defer(false);
                     if (!create_notification_with_title(db, temp_sv_to_cstr(new_title))) {
                         return_defer(false);
                     }
+                    if (!tui_commit(db, &cc)) return_defer(false);
                 }
-                tui_cursor_up(ui_height);
-                gns.count = 0;
-                if (!load_active_grouped_notifications(db, &gns)) return_defer(false);
-                assert(gns.count > 0);
-                cursor = gns.count - 1;
-                ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_NONE, NULL);
+                if (!tui_refresh_notifications(db, &gns, &version)) return_defer(false);
+                cursor = gns.count > 0 ? gns.count - 1 : 0;
+                if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_NONE, NULL)) return_defer(false);
             } break;
             case 'e': {
                 if (cursor >= gns.count) {
-                    tui_cursor_up(ui_height);
-                    ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_NONE, "nothing to edit");
+                    if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_NONE, "nothing to edit")) return_defer(false);
                     continue;
                 }
                 if (gns.items[cursor].group_count > 1) {
                     // TODO: should we allow editing groups of notifications?
-                    tui_cursor_up(ui_height);
-                    ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_NONE, "cannot edit groups yet");
+                    if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_NONE, "cannot edit groups yet")) return_defer(false);
                     continue;
                 }
                 const char *title_path = temp_sprintf("%s/%s", TORE_DIR_PATH, TORE_TITLE_FILE_NAME);
@@ -1965,31 +5146,34 @@ bool tui_run(Command *self, const char *program_name, int argc, char **argv)
                 sb_appendf(&sb, "# Only the first line is important. Everything below it will be ignored.\n");
                 if (!write_entire_file(title_path, sb.items, sb.count)) return_defer(false);
                 String_View new_title = {0};
-                if (!tui_edit_title_file(title_path, &cmd, &sb, &new_title)) return_defer(false);
+                if (!tui_edit_title_file(title_path, &cmd, &sb, &new_title, &saved_sigwinch)) return_defer(false);
+                // The terminal might have been resized while the editor was open and nobody told us
+                tui_viewport_resize(&vp);
+                screen.invalid = true;
+                int group_id = gns.items[cursor].group_id;
                 if (new_title.count > 0) {
                     const char *new_title_cstr = temp_sv_to_cstr(new_title);
                     if (strcmp(new_title_cstr, gns.items[cursor].title) != 0) {
+                        if (!txn_begin_write(db)) return_defer(false);
                         if (!update_notification_title(db, gns.items[cursor].notif_id, new_title_cstr)) {
                             return_defer(false);
                         }
+                        if (!tui_commit(db, &cc)) return_defer(false);
                     }
                 }
-                tui_cursor_up(ui_height);
-                gns.count = 0;
-                if (!load_active_grouped_notifications(db, &gns)) return_defer(false);
-                assert(cursor < gns.count);
-                ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_NONE, NULL);
+                if (!tui_refresh_notifications(db, &gns, &version)) return_defer(false);
+                // Somebody else may have dismissed it while we were in the editor
+                if (!tui_find_group(&gns, group_id, &cursor)) cursor = tui_clamp_cursor(&gns, cursor);
+                if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_NONE, NULL)) return_defer(false);
             } break;
             case '\x1b':
             case '\r':
             case ' ': {
                 if (cursor >= gns.count) {
-                    tui_cursor_up(ui_height);
-                    ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_NONE, "nothing to delete");
+                    if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_NONE, "nothing to delete")) return_defer(false);
                     continue;
                 }
-                tui_cursor_up(ui_height);
-                ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_CONFIRM_DELETE, NULL);
+                if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_CONFIRM_DELETE, NULL)) return_defer(false);
                 state = TUI_STATE_ACTION;
             } break;
             case 'q': return_defer(true);
@@ -1998,26 +5182,19 @@ bool tui_run(Command *self, const char *program_name, int argc, char **argv)
         case TUI_STATE_ACTION: {
             switch (c) {
             case 'd': {
+                if (!txn_begin_write(db)) return_defer(false);
                 if (!dismiss_grouped_notification_by_group_id(db, gns.items[cursor].group_id)) return_defer(false);
-                tui_cursor_up(ui_height);
-                gns.count = 0;
-                if (!load_active_grouped_notifications(db, &gns)) return_defer(false);
-                if (cursor >= gns.count) {
-                    if (gns.count > 0) {
-                        cursor = gns.count - 1;
-                    } else {
-                        cursor = 0;
-                    }
-                }
-                ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_NONE, NULL);
+                if (!tui_commit(db, &cc)) return_defer(false);
+                if (!tui_refresh_notifications(db, &gns, &version)) return_defer(false);
+                cursor = tui_clamp_cursor(&gns, cursor);
+                if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_NONE, NULL)) return_defer(false);
                 state = TUI_STATE_SELECT;
             } break;
             case '\x1b':
             case '\r':
             case ' ':
             case 'q': {
-                tui_cursor_up(ui_height);
-                ui_height = tui_grouped_notifications_selector(&gns, cursor, TAS_NONE, NULL);
+                if (!tui_grouped_notifications_selector(&screen, &gns, cursor, &vp, TAS_NONE, NULL)) return_defer(false);
                 state = TUI_STATE_SELECT;
             } break;
             }
@@ -2027,13 +5204,18 @@ bool tui_run(Command *self, const char *program_name, int argc, char **argv)
     }
 
 defer:
-    if (db) {
-        if (result) result = txn_commit(db);
-        sqlite3_close(db);
-    }
+    // Closing the database rolls back the transaction of the action that failed midway, if any
+    if (db) close_tore_db(db);
+    scratch_arena = NULL;
+    arena_free(&arena);
     free(gns.items);
+    free(cc.mailbox.items);
     free(sb.items);
     free(cmd.items);
+    tui_screen_free(&screen);
+    if (sigwinch_installed) {
+        sigaction(SIGWINCH, &saved_sigwinch, NULL);
+    }
     if (raw_terminal_enabled) {
         tui_disable_raw_terminal_mode(&saved);
     }
@@ -2047,7 +5229,10 @@ static Command commands[] = {
         .name = "checkout",
         .signature = NULL,
         .description = "Fire off the Reminders if needed and show the current Notifications\n"
-            "This is a default command that is executed when you just call Tore by itself.",
+            "This is a default command that is executed when you just call Tore by itself.\n"
+            "All the periods missed by the periodic Reminders are caught up at once, firing off\n"
+            "a single Notification per Reminder. Set $TORE_CATCH_UP_POLICY to `each` to fire off\n"
+            "one Notification per missed period instead, up to " STR(CATCH_UP_EACH_MAX_FIRINGS) " (the default is `collapse`).",
         .run = checkout_run,
     },
     {
@@ -2103,10 +5288,21 @@ static Command commands[] = {
     },
     {
         .name = "serve",
-        .signature = "[port]",
-        .description = "Start up the Web Server. Default port is " STR(DEFAULT_SERVE_PORT) ".",
+        .signature = "[port] [workers] [-stream]",
+        .description = "Start up the Web Server. Default port is " STR(DEFAULT_SERVE_PORT) ".\n"
+                       "The pages are rendered by a pool of worker threads, one per CPU by default.\n"
+                       "With -stream the index page is sent in chunks while it's rendered instead of as a whole.",
         .run = serve_run,
     },
+    {
+        .name = "daemon",
+        .signature = NULL,
+        .description = "Keep the database open and serve the rendered Mailbox through a Unix socket\n"
+            "The socket is located in ~/"TORE_DIR_NAME"/"TORE_DAEMON_SOCKET_FILE_NAME". Every time `checkout` is called it\n"
+            "first asks the daemon for the Mailbox and falls back to opening the database by\n"
+            "itself only if nobody answers. The daemon fires off the Reminders at the local midnight.",
+        .run = daemon_run,
+    },
     {
         .name = "tui",
         .signature = NULL,
@@ -2184,9 +5380,24 @@ int main(int argc, char **argv)
         fprintf(stderr, "ERROR: No $HOME environment variable is setup. We need it to find the location of ~/%s/ directory.\n", TORE_DIR_NAME);
         return 1;
     }
-    TORE_DIR_PATH = temp_sprintf("%s/%s", HOME_PATH, TORE_DIR_NAME);
-    TORE_DB_PATH = temp_sprintf("%s/%s", TORE_DIR_PATH, TORE_DB_NAME);
+    // Not in the temporary buffer, the long running commands (`daemon`, `serve`) reset it regularly
+    TORE_DIR_PATH = strdup(temp_sprintf("%s/%s", HOME_PATH, TORE_DIR_NAME));
+    TORE_DB_PATH = strdup(temp_sprintf("%s/%s", TORE_DIR_PATH, TORE_DB_NAME));
+    TORE_CHECKOUT_CACHE_PATH = strdup(temp_sprintf("%s/%s", TORE_DIR_PATH, TORE_CHECKOUT_CACHE_FILE_NAME));
+    TORE_DAEMON_SOCKET_PATH = strdup(temp_sprintf("%s/%s", TORE_DIR_PATH, TORE_DAEMON_SOCKET_FILE_NAME));
+    assert(TORE_DIR_PATH && TORE_DB_PATH && TORE_CHECKOUT_CACHE_PATH && TORE_DAEMON_SOCKET_PATH && "Buy more RAM lol");
     TORE_TRACE_MIGRATION_QUERIES = getenv("TORE_TRACE_MIGRATION_QUERIES") != NULL;
+    const char *catch_up_policy = getenv("TORE_CATCH_UP_POLICY");
+    if (catch_up_policy != NULL) {
+        if (strcmp(catch_up_policy, "each") == 0) {
+            TORE_CATCH_UP_POLICY = CATCH_UP_EACH;
+        } else if (strcmp(catch_up_policy, "collapse") == 0) {
+            TORE_CATCH_UP_POLICY = CATCH_UP_COLLAPSE;
+        } else {
+            fprintf(stderr, "ERROR: Invalid $TORE_CATCH_UP_POLICY `%s`. Expected `each` or `collapse`.\n", catch_up_policy);
+            return 1;
+        }
+    }
 
     const char *program_name = shift(argv, argc);
     const char *command_name = DEFAULT_COMMAND;
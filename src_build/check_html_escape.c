@@ -0,0 +1,96 @@
+// Compares the SSE2 path of sb_append_html_escaped_buf() and html_escaped_size() against
+// html_escape_scalar(), which is the reference implementation. The inputs are picked around the
+// 16 byte blocks: every length up to a few blocks, the special characters at every position and
+// misaligned starts, plus a bunch of random buffers.
+#define main tore_main
+#include "src/tore.c"
+#undef main
+
+#define MAX_SIZE 1024
+#define RANDOM_ROUNDS 100000
+
+static const char specials[] = "&<>\"'";
+
+static String_Builder expected = {0};
+static String_Builder actual = {0};
+
+bool check_escape(const char *what, const char *buf, size_t size)
+{
+    expected.count = 0;
+    da_reserve(&expected, size*6);
+    char *end = html_escape_scalar(expected.items, buf, size);
+    expected.count = end - expected.items;
+
+    size_t escaped_size = html_escaped_size(buf, size);
+    if (escaped_size != expected.count) {
+        fprintf(stderr, "ERROR: %s: html_escaped_size() is %zu, expected %zu\n", what, escaped_size, expected.count);
+        return false;
+    }
+
+    // Appending to something that is already there, like the templates do
+    actual.count = 0;
+    sb_append_cstr(&actual, "prefix");
+    sb_append_html_escaped_buf(&actual, buf, size);
+    if (actual.count - 6 != expected.count || memcmp(actual.items, "prefix", 6) != 0 || memcmp(actual.items + 6, expected.items, expected.count) != 0) {
+        fprintf(stderr, "ERROR: %s: escaped %zu bytes differently\n", what, size);
+        fprintf(stderr, "    expected: prefix"SV_Fmt"\n", (int) expected.count, expected.items);
+        fprintf(stderr, "    actual:   "SV_Fmt"\n", (int) actual.count, actual.items);
+        return false;
+    }
+    return true;
+}
+
+int main(void)
+{
+    int result = 0;
+    char *buf = malloc(MAX_SIZE + 16);
+    assert(buf != NULL && "Buy more RAM lol");
+
+#ifndef __SSE2__
+    fprintf(stderr, "WARNING: built without SSE2, only the scalar path is checked\n");
+#endif // __SSE2__
+
+    for (size_t offset = 0; offset < 16; ++offset) {
+        char *input = buf + offset;
+        for (size_t size = 0; size <= 70; ++size) {
+            memset(input, 'a', size);
+            if (!check_escape("clean", input, size)) return_defer(1);
+
+            for (size_t pos = 0; pos < size; ++pos) {
+                for (size_t s = 0; s < ARRAY_LEN(specials) - 1; ++s) {
+                    memset(input, 'a', size);
+                    input[pos] = specials[s];
+                    if (!check_escape("one special", input, size)) return_defer(1);
+                }
+            }
+
+            for (size_t s = 0; s < ARRAY_LEN(specials) - 1; ++s) {
+                memset(input, specials[s], size);
+                if (!check_escape("all special", input, size)) return_defer(1);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < 256; ++i) buf[i] = (char) i;
+    if (!check_escape("every byte", buf, 256)) return_defer(1);
+
+    // Fixed seed, so a failure can be reproduced
+    srand(69);
+    for (size_t round = 0; round < RANDOM_ROUNDS; ++round) {
+        size_t offset = rand()%16;
+        size_t size = rand()%(MAX_SIZE - offset + 1);
+        // Dense enough in specials to hit several of them in the same block
+        for (size_t i = 0; i < size; ++i) {
+            buf[offset + i] = rand()%8 == 0 ? specials[rand()%(ARRAY_LEN(specials) - 1)] : (char) rand();
+        }
+        if (!check_escape("random", buf + offset, size)) return_defer(1);
+    }
+
+    printf("OK: the SSE2 and the scalar escapers agree\n");
+
+defer:
+    free(buf);
+    free(expected.items);
+    free(actual.items);
+    return result;
+}
@@ -0,0 +1,220 @@
+// Runs the hot queries of tore against a fresh schema and asserts on their EXPLAIN QUERY PLAN, so they
+// keep using the partial indexes from migrations[] instead of scanning the whole history of dismissed
+// Notifications and finished Reminders.
+//
+// The queries are not copied in here. The check includes src/tore.c, runs the actual functions and
+// records every statement they execute with sqlite3_trace_v2().
+#define main tore_main
+#include "src/tore.c"
+#undef main
+
+typedef struct {
+    char **items;
+    size_t count;
+    size_t capacity;
+} Traced_Queries;
+
+int trace_query(unsigned type, void *context, void *p, void *x)
+{
+    UNUSED(type);
+    UNUSED(x);
+    Traced_Queries *traced = context;
+    const char *sql = sqlite3_sql(p);
+    if (sql == NULL) return 0;
+    for (size_t i = 0; i < traced->count; ++i) {
+        if (strcmp(traced->items[i], sql) == 0) return 0;
+    }
+    char *copy = strdup(sql);
+    assert(copy != NULL && "Buy more RAM lol");
+    da_append(traced, copy);
+    return 0;
+}
+
+void traced_queries_reset(Traced_Queries *traced)
+{
+    for (size_t i = 0; i < traced->count; ++i) free(traced->items[i]);
+    traced->count = 0;
+}
+
+// The recursive CTE and the subquery of fire_off_reminders() are always scanned, but they only contain
+// the due Reminders which are found through the index
+static const char *derived_tables[] = {"Firings", "Last"};
+
+bool is_full_scan(const char *detail)
+{
+    if (strncmp(detail, "SCAN ", 5) != 0) return false;
+    const char *name = detail + 5;
+    if (strstr(name, " USING ")) return false;
+    if (strcmp(name, "CONSTANT ROW") == 0) return false;
+    for (size_t i = 0; i < ARRAY_LEN(derived_tables); ++i) {
+        if (strcmp(name, derived_tables[i]) == 0) return false;
+    }
+    return true;
+}
+
+// The index name is either followed by the constraints in parens or ends the detail
+bool uses_index(const char *detail, const char *index)
+{
+    const char *needle = temp_sprintf("INDEX %s", index);
+    const char *at = strstr(detail, needle);
+    if (at == NULL) return false;
+    char next = at[strlen(needle)];
+    return next == ' ' || next == '\0';
+}
+
+typedef struct {
+    const char *name;
+    const char *indexes[2];     // Every one of them must be used by at least one of the queries
+    bool no_sorting;            // The order comes from the index, so there must be no temporary B-tree
+} Hot_Operation;
+
+bool check_plans(sqlite3 *db, const Hot_Operation *op, Traced_Queries *traced)
+{
+    bool result = true;
+    bool used[ARRAY_LEN(op->indexes)] = {0};
+    sqlite3_stmt *stmt = NULL;
+
+    printf("%s:\n", op->name);
+    for (size_t i = 0; i < traced->count; ++i) {
+        const char *sql = traced->items[i];
+        if (strncmp(sql, "BEGIN", 5) == 0 || strncmp(sql, "COMMIT", 6) == 0 || strncmp(sql, "PRAGMA", 6) == 0) continue;
+
+        if (sqlite3_prepare_v2(db, temp_sprintf("EXPLAIN QUERY PLAN %s", sql), -1, &stmt, NULL) != SQLITE_OK) {
+            LOG_SQLITE3_ERROR(db);
+            return_defer(false);
+        }
+        printf("    %s\n", sql);
+        int ret;
+        for (ret = sqlite3_step(stmt); ret == SQLITE_ROW; ret = sqlite3_step(stmt)) {
+            const char *detail = (const char *)sqlite3_column_text(stmt, 3);
+            printf("        %s\n", detail);
+            if (is_full_scan(detail)) {
+                fprintf(stderr, "ERROR: %s: full table scan: %s\n", op->name, detail);
+                result = false;
+            }
+            if (op->no_sorting && strstr(detail, "TEMP B-TREE")) {
+                fprintf(stderr, "ERROR: %s: the rows are sorted instead of coming in the index order: %s\n", op->name, detail);
+                result = false;
+            }
+            for (size_t j = 0; j < ARRAY_LEN(op->indexes); ++j) {
+                if (op->indexes[j] && uses_index(detail, op->indexes[j])) used[j] = true;
+            }
+        }
+        if (ret != SQLITE_DONE) {
+            LOG_SQLITE3_ERROR(db);
+            return_defer(false);
+        }
+        sqlite3_finalize(stmt);
+        stmt = NULL;
+    }
+
+    for (size_t j = 0; j < ARRAY_LEN(op->indexes); ++j) {
+        if (op->indexes[j] && !used[j]) {
+            fprintf(stderr, "ERROR: %s: %s is not used\n", op->name, op->indexes[j]);
+            result = false;
+        }
+    }
+
+defer:
+    if (stmt) sqlite3_finalize(stmt);
+    traced_queries_reset(traced);
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+    sqlite3 *db = NULL;
+    Traced_Queries traced = {0};
+    Grouped_Notifications gns = {0};
+    Reminders reminders = {0};
+    Checkout_Cache cc = {0};
+    Page_Cursor next = {0};
+
+    char dir_path[] = "/tmp/tore-check-XXXXXX";
+    if (mkdtemp(dir_path) == NULL) {
+        fprintf(stderr, "ERROR: Could not create a temporary directory: %s\n", strerror(errno));
+        return 1;
+    }
+    TORE_DIR_PATH = dir_path;
+    TORE_DB_PATH = ":memory:";
+
+    db = open_tore_db();
+    if (!db) return_defer(1);
+
+    // A bit of everything, so every branch of the hot queries has something to do
+    const char *seed =
+        "INSERT INTO Reminders (title, scheduled_at, period) VALUES ('daily', '2020-01-01', '+1 days'), ('monthly', '2020-01-31', '+1 months'), ('once', '2020-01-01', NULL);\n"
+        "INSERT INTO Notifications (title, reminder_id) VALUES ('fired', 1), ('fired', 1);\n"
+        "INSERT INTO Notifications (title) VALUES ('foo'), ('bar');\n"
+        "UPDATE Notifications SET dismissed_at = CURRENT_TIMESTAMP WHERE title = 'bar';\n";
+    if (sqlite3_exec(db, seed, NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(1);
+    }
+
+    if (sqlite3_trace_v2(db, SQLITE_TRACE_STMT, trace_query, &traced) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(1);
+    }
+
+    Hot_Operation op = {0};
+
+    op = (Hot_Operation) { .name = "load_active_grouped_notifications", .indexes = {"Notifications_active_by_group"} };
+    if (!load_active_grouped_notifications(db, &gns)) return_defer(1);
+    if (!check_plans(db, &op, &traced)) result = 1;
+
+    op = (Hot_Operation) { .name = "load_active_grouped_notifications_page", .indexes = {"Notifications_active_by_created_at", "Notifications_active_by_group"}, .no_sorting = true };
+    gns.count = 0;
+    if (!load_active_grouped_notifications_page(db, (Page_Cursor) {0}, 1, &gns, &next)) return_defer(1);
+    gns.count = 0;
+    if (!load_active_grouped_notifications_page(db, next, 1, &gns, &next)) return_defer(1);
+    if (!check_plans(db, &op, &traced)) result = 1;
+
+    op = (Hot_Operation) { .name = "load_active_reminders_page", .indexes = {"Reminders_active_by_scheduled_at"}, .no_sorting = true };
+    if (!load_active_reminders_page(db, (Page_Cursor) {0}, 1, &reminders, &next)) return_defer(1);
+    reminders.count = 0;
+    if (!load_active_reminders_page(db, next, 1, &reminders, &next)) return_defer(1);
+    if (!check_plans(db, &op, &traced)) result = 1;
+
+    op = (Hot_Operation) { .name = "checkout_cache_prepare", .indexes = {"Notifications_active_by_group", "Reminders_active_by_scheduled_at"} };
+    if (!checkout_cache_prepare(db, &cc)) return_defer(1);
+    if (!check_plans(db, &op, &traced)) result = 1;
+
+    op = (Hot_Operation) { .name = "fire_off_reminders (each)", .indexes = {"Reminders_active_by_scheduled_at"} };
+    TORE_CATCH_UP_POLICY = CATCH_UP_EACH;
+    if (!fire_off_reminders(db)) return_defer(1);
+    if (!check_plans(db, &op, &traced)) result = 1;
+
+    op = (Hot_Operation) { .name = "fire_off_reminders (collapse)", .indexes = {"Reminders_active_by_scheduled_at"} };
+    TORE_CATCH_UP_POLICY = CATCH_UP_COLLAPSE;
+    if (!fire_off_reminders(db)) return_defer(1);
+    if (!check_plans(db, &op, &traced)) result = 1;
+
+    op = (Hot_Operation) { .name = "tui_refresh_notifications", .indexes = {"Notifications_by_version", "Notifications_active_by_group"} };
+    int version = 0;
+    if (sqlite3_exec(db, "UPDATE Notifications SET title = 'foo' WHERE title = 'foo';", NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(1);
+    }
+    traced_queries_reset(&traced);
+    gns.count = 0;
+    if (!tui_refresh_notifications(db, &gns, &version)) return_defer(1);
+    if (!check_plans(db, &op, &traced)) result = 1;
+
+    op = (Hot_Operation) { .name = "dismiss_grouped_notification_by_group_id", .indexes = {"Notifications_active_by_group"} };
+    if (!dismiss_grouped_notification_by_group_id(db, 1)) return_defer(1);
+    if (!check_plans(db, &op, &traced)) result = 1;
+
+    if (result == 0) printf("OK: all the hot queries use their indexes\n");
+
+defer:
+    if (db) close_tore_db(db);
+    traced_queries_reset(&traced);
+    free(traced.items);
+    free(gns.items);
+    free(reminders.items);
+    free(cc.mailbox.items);
+    rmdir(dir_path);
+    return result;
+}
@@ -0,0 +1,149 @@
+// Runs `serve` in a child process and makes an /events subscriber hang up in the same wakeup of the
+// event loop as a change of the database. Sending the events to that subscriber finds out that it's gone
+// and closes it, while the hang up itself is still waiting further down the same batch of epoll events.
+//
+// To get both into one batch the server is stopped with SIGSTOP while they happen. The check is built
+// with AddressSanitizer, so touching the closed connection afterwards aborts the server.
+#define main tore_main
+#include "src/tore.c"
+#undef main
+
+#define CHECK_TIMEOUT_MS 5000
+
+int connect_server(uint16_t port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = inet_addr("127.0.0.1"),
+    };
+    for (int attempt = 0; attempt < CHECK_TIMEOUT_MS/10; ++attempt) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) return fd;
+        close(fd);
+        usleep(10*1000);
+    }
+    return -1;
+}
+
+// Reads from the client until the received data contains the needle
+bool read_until(int fd, String_Builder *received, const char *needle)
+{
+    struct timeval timeout = { .tv_sec = CHECK_TIMEOUT_MS/1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    for (;;) {
+        sb_append_null(received);
+        received->count -= 1;
+        if (strstr(received->items, needle)) return true;
+        char buffer[4096];
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) return false;
+        sb_append_buf(received, buffer, n);
+    }
+}
+
+int subscribe(uint16_t port)
+{
+    int fd = connect_server(port);
+    if (fd < 0) return -1;
+    const char *request = "GET /events HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    String_Builder received = {0};
+    bool ok = write(fd, request, strlen(request)) == (ssize_t)strlen(request) && read_until(fd, &received, "retry: 3000\n\n");
+    free(received.items);
+    if (!ok) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(void)
+{
+    int result = 0;
+    pid_t server = -1;
+    int gone = -1;
+    int staying = -1;
+    sqlite3 *db = NULL;
+    String_Builder received = {0};
+    uint16_t port = 20000 + getpid()%20000;
+
+    char dir_path[] = "/tmp/tore-check-XXXXXX";
+    if (mkdtemp(dir_path) == NULL) {
+        fprintf(stderr, "ERROR: Could not create a temporary directory: %s\n", strerror(errno));
+        return 1;
+    }
+    TORE_DIR_PATH = dir_path;
+    TORE_DB_PATH = temp_sprintf("%s/%s", dir_path, TORE_DB_NAME);
+
+    // Creating the schema upfront, so the server does not race with us for it
+    db = open_tore_db();
+    if (!db) return_defer(1);
+
+    fflush(stdout);
+    server = fork();
+    if (server < 0) {
+        fprintf(stderr, "ERROR: Could not fork the server: %s\n", strerror(errno));
+        return_defer(1);
+    }
+    if (server == 0) {
+        close_tore_db(db);
+        Command serve = { .name = "serve" };
+        char *argv[] = { temp_sprintf("%u", port), "1" };
+        _exit(serve_run(&serve, "check_serve_events", ARRAY_LEN(argv), argv) ? 0 : 1);
+    }
+
+    gone = subscribe(port);
+    staying = subscribe(port);
+    if (gone < 0 || staying < 0) {
+        fprintf(stderr, "ERROR: Could not subscribe to /events on port %u\n", port);
+        return_defer(1);
+    }
+
+    if (kill(server, SIGSTOP) < 0 || waitpid(server, NULL, WUNTRACED) < 0) {
+        fprintf(stderr, "ERROR: Could not stop the server: %s\n", strerror(errno));
+        return_defer(1);
+    }
+    // The change first, so inotify comes before the subscriber in the batch
+    if (sqlite3_exec(db, "INSERT INTO Notifications (title) VALUES ('check');", NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(1);
+    }
+    // Resetting the connection instead of the graceful shutdown, so writing the event into it fails
+    struct linger linger = { .l_onoff = 1, .l_linger = 0 };
+    setsockopt(gone, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    close(gone);
+    gone = -1;
+    kill(server, SIGCONT);
+
+    if (!read_until(staying, &received, "event: added\n")) {
+        fprintf(stderr, "ERROR: The subscriber that stayed did not receive the event\n");
+        return_defer(1);
+    }
+
+    // The server must still be around to accept new subscribers
+    int again = subscribe(port);
+    if (again < 0) {
+        fprintf(stderr, "ERROR: The server does not accept subscribers anymore\n");
+        return_defer(1);
+    }
+    close(again);
+
+    printf("OK: a subscriber hanging up in the same wakeup as a change is closed safely\n");
+
+defer:
+    if (gone >= 0) close(gone);
+    if (staying >= 0) close(staying);
+    if (server > 0) {
+        kill(server, SIGCONT);
+        kill(server, SIGKILL);
+        waitpid(server, NULL, 0);
+    }
+    if (db) close_tore_db(db);
+    free(received.items);
+    unlink(TORE_DB_PATH);
+    unlink(temp_sprintf("%s-wal", TORE_DB_PATH));
+    unlink(temp_sprintf("%s-shm", TORE_DB_PATH));
+    rmdir(dir_path);
+    return result;
+}
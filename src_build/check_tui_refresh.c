@@ -0,0 +1,122 @@
+// Makes random changes to the Notifications and compares the Mailbox patched by tui_refresh_notifications()
+// with the one loaded from scratch by tui_load_notifications() after each of them.
+#define main tore_main
+#include "src/tore.c"
+#undef main
+
+#define ROUNDS 2000
+
+// The groups of the same second may come in any order, just like with ORDER BY ts
+int compare_grouped_notifications(const void *a, const void *b)
+{
+    const Grouped_Notification *x = a;
+    const Grouped_Notification *y = b;
+    int cmp = strcmp(x->created_at, y->created_at);
+    if (cmp != 0) return cmp;
+    return (x->group_id > y->group_id) - (x->group_id < y->group_id);
+}
+
+bool same_mailbox(Grouped_Notifications *patched, Grouped_Notifications *loaded)
+{
+    if (patched->count != loaded->count) {
+        fprintf(stderr, "ERROR: %zu groups after the refresh, expected %zu\n", patched->count, loaded->count);
+        return false;
+    }
+    for (size_t i = 1; i < patched->count; ++i) {
+        if (strcmp(patched->items[i - 1].created_at, patched->items[i].created_at) > 0) {
+            fprintf(stderr, "ERROR: the group %d is out of order after the refresh\n", patched->items[i].group_id);
+            return false;
+        }
+    }
+    qsort(patched->items, patched->count, sizeof(*patched->items), compare_grouped_notifications);
+    qsort(loaded->items, loaded->count, sizeof(*loaded->items), compare_grouped_notifications);
+    for (size_t i = 0; i < patched->count; ++i) {
+        Grouped_Notification *p = &patched->items[i];
+        Grouped_Notification *l = &loaded->items[i];
+        if (p->group_id != l->group_id || p->group_count != l->group_count || strcmp(p->title, l->title) != 0) {
+            fprintf(stderr, "ERROR: the group %d is [%d] %s after the refresh, expected the group %d [%d] %s\n",
+                    p->group_id, p->group_count, p->title, l->group_id, l->group_count, l->title);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(void)
+{
+    int result = 0;
+    sqlite3 *db = NULL;
+    Arena patched_arena = {0};
+    Arena loaded_arena = {0};
+    Grouped_Notifications patched = {0};
+    Grouped_Notifications loaded = {0};
+    int patched_version = 0;
+    int loaded_version = 0;
+
+    char dir_path[] = "/tmp/tore-check-XXXXXX";
+    if (mkdtemp(dir_path) == NULL) {
+        fprintf(stderr, "ERROR: Could not create a temporary directory: %s\n", strerror(errno));
+        return 1;
+    }
+    TORE_DIR_PATH = dir_path;
+    TORE_DB_PATH = ":memory:";
+
+    db = open_tore_db();
+    if (!db) return_defer(1);
+
+    const char *seed =
+        "INSERT INTO Reminders (title, scheduled_at, period) VALUES ('foo', '2020-01-01', '+1 days'), ('bar', '2020-01-01', '+1 days'), ('baz', '2020-01-01', NULL);\n";
+    if (sqlite3_exec(db, seed, NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_SQLITE3_ERROR(db);
+        return_defer(1);
+    }
+
+    scratch_arena = &patched_arena;
+    if (!tui_load_notifications(db, &patched_arena, &patched, &patched_version)) return_defer(1);
+
+    // Fixed seed, so a failure can be reproduced
+    srand(69);
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        // A few seconds only, so there are plenty of groups created in the same second
+        const char *created_at = temp_sprintf("2020-01-01 00:00:%02d", rand()%8);
+        const char *sql = NULL;
+        switch (rand()%5) {
+        case 0: sql = temp_sprintf("INSERT INTO Notifications (title, created_at) VALUES ('single %zu', '%s');", round, created_at); break;
+        case 1: sql = temp_sprintf("INSERT INTO Notifications (title, created_at, reminder_id) VALUES ('fired %zu', '%s', %d);", round, created_at, 1 + rand()%3); break;
+        case 2: sql = temp_sprintf("UPDATE Notifications SET title = 'edited %zu' WHERE id = %d;", round, 1 + rand()%(int)(round + 1)); break;
+        case 3: sql = temp_sprintf("UPDATE Notifications SET dismissed_at = CURRENT_TIMESTAMP WHERE dismissed_at IS NULL AND ifnull(reminder_id, -id) = %d;", rand()%2 ? 1 + rand()%3 : -(1 + rand()%(int)(round + 1))); break;
+        case 4: sql = "BEGIN; INSERT INTO Notifications (title) VALUES ('one'); INSERT INTO Notifications (title, reminder_id) VALUES ('two', 2); UPDATE Notifications SET title = 'three' WHERE id = 1; COMMIT;"; break;
+        }
+        if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+            LOG_SQLITE3_ERROR(db);
+            return_defer(1);
+        }
+
+        scratch_arena = &patched_arena;
+        if (!tui_refresh_notifications(db, &patched, &patched_version)) return_defer(1);
+        scratch_arena = &loaded_arena;
+        if (!tui_load_notifications(db, &loaded_arena, &loaded, &loaded_version)) return_defer(1);
+
+        if (patched_version != loaded_version) {
+            fprintf(stderr, "ERROR: %s: the version is %d after the refresh, expected %d\n", sql, patched_version, loaded_version);
+            return_defer(1);
+        }
+        if (!same_mailbox(&patched, &loaded)) {
+            fprintf(stderr, "ERROR: after %s\n", sql);
+            return_defer(1);
+        }
+        temp_reset();
+    }
+
+    printf("OK: the refreshed Mailbox matches the loaded one after %d changes\n", ROUNDS);
+
+defer:
+    if (db) close_tore_db(db);
+    scratch_arena = NULL;
+    arena_free(&patched_arena);
+    arena_free(&loaded_arena);
+    free(patched.items);
+    free(loaded.items);
+    rmdir(dir_path);
+    return result;
+}
@@ -9,6 +9,7 @@
 // - Inclusion of compiled templates into the body of C functions with macro parameters like OUT, ESCAPE_OUT, etc.,
 // - Implied semicolons in template parameter macros,
 // - Nested macros with %#include BODY% pattern,
+// - TEMPLATE_STATIC_BYTES(n) hook at the top of each template for reserving the output,
 // - HTML escaping,
 // - ...
 
@@ -16,25 +17,54 @@
 #define NOB_STRIP_PREFIX
 #include "nob.h"
 
+// The generated code is collected first, because the TEMPLATE_STATIC_BYTES(n) hook at the top
+// needs to know how much static text the whole template has.
+String_Builder code = {0};
+size_t static_bytes = 0;
+// The static text is not emitted until the next non-blank C code, so the adjacent static segments
+// end up in a single OUT() call.
+String_Builder pending = {0};
+
+bool sv_is_blank(String_View s)
+{
+    return sv_trim(s).count == 0;
+}
+
 void compile_c_code(String_View s) {
-    printf("%.*s\n", (int) s.count, s.data);
+    sb_appendf(&code, "%.*s\n", (int) s.count, s.data);
 }
 
 void compile_byte_array(String_View s) {
-    printf("OUT(\"");
+    if (s.count == 0) return;
+    sb_append_cstr(&code, "OUT(\"");
     for (uint64_t i = 0; i < s.count; ++i) {
-        printf("\\x%02x", s.data[i]);
+        sb_appendf(&code, "\\x%02x", (unsigned char)s.data[i]);
     }
-    printf("\", %lu);\n", s.count);
+    sb_appendf(&code, "\", %zu);\n", s.count);
+    static_bytes += s.count;
+}
+
+void flush_pending(void)
+{
+    compile_byte_array(sb_to_sv(pending));
+    pending.count = 0;
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: ./tt <template.h.tt>\n");
+    const char *program_name = shift(argv, argc);
+    // Minification drops the whitespace-only text between the C code blocks. That's mostly the
+    // indentation of the control flow, but it's up to the template not to rely on it otherwise.
+    bool minify = false;
+    if (argc > 0 && strcmp(argv[0], "-minify") == 0) {
+        minify = true;
+        shift(argv, argc);
+    }
+    if (argc < 1) {
+        fprintf(stderr, "Usage: %s [-minify] <template.h.tt>\n", program_name);
         return 1;
     }
-    const char *filepath = argv[1];
+    const char *filepath = argv[0];
     String_Builder sb = {0};
     if (!nob_read_entire_file(filepath, &sb)) return 1;
     String_View temp = sb_to_sv(sb);
@@ -45,12 +75,19 @@ int main(int argc, char *argv[])
     while (temp.count) {
         String_View token = sv_chop_by_delim(&temp, '%');
         if (c_code_mode) {
-            compile_c_code(token);
+            if (!sv_is_blank(token)) {
+                flush_pending();
+                compile_c_code(token);
+            }
         } else {
-            compile_byte_array(token);
+            if (!(minify && sv_is_blank(token))) sb_append_buf(&pending, token.data, token.count);
         }
         c_code_mode = !c_code_mode;
     }
+    flush_pending();
+
+    printf("TEMPLATE_STATIC_BYTES(%zu);\n", static_bytes);
+    printf("%.*s", (int) code.count, code.items);
 
     return 0;
 }